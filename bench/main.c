@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/canard.h"
+
+#define T_OBJS 100000
+#define T_QUERIES 2000
+#define NAME_SIZE 32
+
+typedef void (*NameGenerator)(char *, int);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Quake-style names, such as "r_shadow_quality_123"
+static void quake_name(char *buf, int i) {
+    const char *prefixes[] = {"r", "cl", "sv", "snd", "net", "in", "g"};
+    const char *words[] = {
+        "shadow", "quality", "texture", "filter", "volume", "rate", "max",
+        "min", "speed", "draw", "world", "model", "light", "mouse", "sens",
+    };
+    snprintf(buf, NAME_SIZE, "%s_%s_%s_%d", prefixes[rand() % 7],
+             words[rand() % 15], words[rand() % 15], i);
+}
+
+// Random lowercase names of 6 to 13 letters
+static void random_name(char *buf, int i) {
+    int len = 6 + rand() % 8;
+    for (int j = 0; j < len; j++) {
+        buf[j] = 'a' + rand() % 26;
+    }
+    buf[len] = 0;
+}
+
+// Apply one random insertion, deletion or substitution
+static void make_typo(char *buf, const char *name) {
+    int len = (int)strlen(name);
+    int at = rand() % len;
+    char c = 'a' + rand() % 26;
+    switch (rand() % 3) {
+        case 0:
+            snprintf(buf, NAME_SIZE, "%.*s%c%s", at, name, c, name + at);
+            break;
+        case 1:
+            snprintf(buf, NAME_SIZE, "%.*s%s", at, name, name + at + 1);
+            break;
+        default:
+            snprintf(buf, NAME_SIZE, "%.*s%c%s", at, name, c, name + at + 1);
+            break;
+    }
+}
+
+static void bench(const char *label, NameGenerator generate) {
+    char (*names)[NAME_SIZE] = malloc(sizeof(*names) * T_OBJS);
+    CnVarDecl *vars = calloc(T_OBJS + 1, sizeof(CnVarDecl));
+    for (int i = 0; i < T_OBJS; i++) {
+        generate(names[i], i);
+        vars[i].name = names[i];
+        vars[i].type = CVAR_INT;
+    }
+
+    double start = now();
+    CnSchema *schema = canard_create_schema("bench", NULL, vars);
+    double build = now() - start;
+    if (!schema) {
+        // Random names may collide; those runs are simply skipped
+        printf("%s: duplicate names, skipped\n", label);
+        free(vars);
+        free(names);
+        return;
+    }
+
+    Console con;
+    canard_init(&con, "canard_bench");
+    canard_attach_namespace(&con, schema);
+    con.output = fopen("/dev/null", "w");
+
+    char typo[NAME_SIZE];
+    start = now();
+    for (int i = 0; i < T_QUERIES; i++) {
+        make_typo(typo, names[rand() % T_OBJS]);
+        canard_exec(&con, typo);
+    }
+    double lookup = (now() - start) / T_QUERIES;
+
+    printf("%s: %d objects, schema built in %.1f ms, "
+           "%.1f us per mistyped lookup\n",
+           label, T_OBJS, build * 1e3, lookup * 1e6);
+
+    fclose(con.output);
+    canard_teardown(&con);
+    canard_destroy_schema(schema);
+    free(vars);
+    free(names);
+}
+
+int main(int argc, const char *argv[]) {
+    srand(1);
+    bench("quake", quake_name);
+    bench("random", random_name);
+    return 0;
+}
@@ -7,31 +7,33 @@ typedef struct DemoHandler {
     int serves_nothing;
 } DemoHandler;
 
-bool callback_dummy(void *handler, Console *con, CVarValue value) {
-    if (value > 0) {
-        sprintf(con->output, "dummy is positive!");
-    } else if (value < 0) {
-        sprintf(con->output, "dummy is negative!");
+static void callback_dummy(void *handler, Console *con, CnVarValue *value) {
+    if (value->i_val > 0) {
+        fprintf(con->output, "dummy is positive!\n");
+    } else if (value->i_val < 0) {
+        fprintf(con->output, "dummy is negative!\n");
     } else {
-        sprintf(con->output, "dummy is zero!");
+        fprintf(con->output, "dummy is zero!\n");
     }
-    return true;
 }
 
+static const CnVarDecl demo_vars[] = {
+    {"dummy", callback_dummy, CVAR_INT, NULL, "Doesn't do anything"},
+    END_VAR_DECL
+};
+
 int main(int argc, const char *argv[]) {
     Console con;
     canard_init(&con, "canard_demo");
-    
-    Namespace *ns = canard_create_namespace(&con, "demo");
-    canard_create_variable(ns, "dummy", CVAR_INT, callback_dummy,
-                           "Doesn't do anything");
-    
-    canard_parse_args(&con, argc, argv);
-    
+
+    CnNamespace *ns = canard_create_namespace(&con, "demo", NULL, demo_vars);
+
     DemoHandler handler;
-    memset(handler, 0, sizeof(DemoHandler));
+    memset(&handler, 0, sizeof(DemoHandler));
     canard_namespace_set_handler(ns, &handler);
 
+    canard_parse_args(&con, argc - 1, argv + 1, "help");
+
     canard_teardown(&con);
     return 0;
 }
@@ -0,0 +1,99 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/canard.h"
+
+#define OUTPUT_SIZE (1 << 20)
+#define JOURNAL_SIZE (64 << 20)
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-q] [-j journal] [-r journal] [files...]\n"
+            "Execute console statements read from files, or standard input.\n"
+            "\t-q\tDo not print the summary\n"
+            "\t-j\tJournal executed statements to a file\n"
+            "\t-r\tReplay a journal before reading any statement\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    bool quiet = false;
+    const char *journal = NULL;
+    const char *replay = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "qj:r:h")) != -1) {
+        switch (opt) {
+            case 'q':
+                quiet = true;
+                break;
+            case 'j':
+                journal = optarg;
+                break;
+            case 'r':
+                replay = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    // Console output is only flushed when the buffer fills up, or at exit
+    setvbuf(stdout, NULL, _IOFBF, OUTPUT_SIZE);
+
+    Console con;
+    canard_init(&con, "canard");
+    if (journal && !canard_journal_open(&con, journal, JOURNAL_SIZE)) {
+        fprintf(stderr, "%s: Failed to open journal\n", journal);
+        canard_teardown(&con);
+        return 1;
+    }
+
+    CnRunStats stats;
+    memset(&stats, 0, sizeof(CnRunStats));
+    bool failed = false;
+    double start = now();
+    if (replay) {
+        int replayed = canard_journal_replay(&con, replay);
+        if (replayed < 0) {
+            failed = true;
+        } else {
+            stats.statements += replayed;
+        }
+    }
+    if (optind >= argc) {
+        failed |= !canard_exec_fd(&con, STDIN_FILENO, &stats);
+    }
+    for (int i = optind; i < argc; i++) {
+        int fd = open(argv[i], O_RDONLY);
+        if (fd < 0 || !canard_exec_fd(&con, fd, &stats)) {
+            fprintf(stderr, "%s: Failed to read file\n", argv[i]);
+            failed = true;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    fflush(stdout);
+    double elapsed = now() - start;
+
+    if (!quiet) {
+        fprintf(stderr,
+                "%ld statements, %ld errors in %.3f s "
+                "(%.0f statements/s, %.1f MB/s)\n",
+                stats.statements, stats.errors, elapsed,
+                elapsed > 0 ? stats.statements / elapsed : 0,
+                elapsed > 0 ? stats.bytes / elapsed / 1e6 : 0);
+    }
+    canard_teardown(&con);
+    return (failed || stats.errors) ? 1 : 0;
+}
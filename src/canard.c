@@ -1,9 +1,23 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "canard.h"
 
-const char *cvar_type_names[] = {"boolean", "integer", "string"};
+const char *cvar_type_names[] = {"boolean", "integer", "string",
+                                 "64-bit integer", "float", "double"};
 
 // MEMORY UTILITIES //
 
@@ -14,44 +28,331 @@ static void *malloc_zeroed(size_t size) {
 }
 
 static char *save_path_filename(Console *con, const char *fn) {
-    CnVariable *cvar = &(canard_find_object(con->nss, "save_path")->sub.var);
-    const char *save_path = canard_get_cvar_str(cvar);
-    char *full_fn = malloc(strlen(save_path) + strlen(fn) + 1);
+    const CnVariable *cvar = &(canard_find_object(con->nss,
+                                                  "save_path")->sub.var);
+    const char *save_path = canard_get_cvar_str(con->nss, cvar);
+    // Room for the separator and the terminator
+    char *full_fn = malloc(strlen(save_path) + strlen(fn) + 2);
     strcpy(full_fn, save_path);
     strcat(full_fn, "/");
     strcat(full_fn, fn);
     return full_fn;
 }
 
-static void print_value(FILE *f, CnVarType type, CnVarValue *value) {
+// NUMERIC CONVERSIONS //
+
+#define NUMBER_BUFFER 32
+
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static void create_c_locale(void) {
+    c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+
+static bool parse_int64(const char *str, int64_t *value) {
+    const char *p = str;
+    bool negative = (*p == '-');
+    if (*p == '-' || *p == '+') {
+        p++;
+    }
+    int base = 10;
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+    }
+    if (!*p) {
+        return false;
+    }
+    // Accumulate as a negative number, whose range is the larger one
+    int64_t limit = (negative ? INT64_MIN : -INT64_MAX);
+    int64_t acc = 0;
+    for (; *p; p++) {
+        int digit;
+        if (*p >= '0' && *p <= '9') {
+            digit = *p - '0';
+        } else if (base == 16 && (*p | 0x20) >= 'a' && (*p | 0x20) <= 'f') {
+            digit = (*p | 0x20) - 'a' + 10;
+        } else {
+            return false;
+        }
+        if (acc < (limit + digit) / base) {
+            return false;
+        }
+        acc = acc * base - digit;
+    }
+    *value = (negative ? acc : -acc);
+    return true;
+}
+
+/*
+ * Split a plain decimal number into a mantissa of up to 19 significant digits
+ * and a power of ten. Returns false if the number has more digits than that,
+ * or is not in the plain decimal form (hexadecimal, infinity, NaN, ...).
+ */
+static bool scan_decimal(const char *str, bool *negative, uint64_t *mantissa,
+                         int *exponent) {
+    const char *p = str;
+    *negative = (*p == '-');
+    if (*p == '-' || *p == '+') {
+        p++;
+    }
+    *mantissa = 0;
+    *exponent = 0;
+    int n_digits = 0;
+    bool truncated = false;
+    const char *digits = p;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        if (n_digits < 19) {
+            *mantissa = *mantissa * 10 + (*p - '0');
+            n_digits += (*mantissa != 0);
+        } else {
+            truncated = true;
+            (*exponent)++;
+        }
+    }
+    if (*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++) {
+            if (n_digits < 19) {
+                *mantissa = *mantissa * 10 + (*p - '0');
+                n_digits += (*mantissa != 0);
+                (*exponent)--;
+            } else {
+                truncated = true;
+            }
+        }
+    }
+    if (p == digits || (p == digits + 1 && *digits == '.')) {
+        return false;
+    }
+    if (*p == 'e' || *p == 'E') {
+        p++;
+        bool exp_negative = (*p == '-');
+        if (*p == '-' || *p == '+') {
+            p++;
+        }
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        int exp = 0;
+        for (; *p >= '0' && *p <= '9'; p++) {
+            if (exp < 100000) {
+                exp = exp * 10 + (*p - '0');
+            }
+        }
+        *exponent += (exp_negative ? -exp : exp);
+    }
+    return !*p && !truncated;
+}
+
+/*
+ * Numbers whose mantissa and power of ten are both exactly representable are
+ * converted with a single correctly rounded operation (Clinger's fast path).
+ * Anything else falls back to strtod() in the C locale. Finite input that
+ * overflows to infinity is rejected.
+ */
+static bool parse_double(const char *str, double *value) {
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    bool negative;
+    uint64_t mantissa;
+    int exponent;
+    if (scan_decimal(str, &negative, &mantissa, &exponent) &&
+        mantissa <= (UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double v = (double)mantissa;
+        v = (exponent < 0 ? v / powers_of_ten[-exponent] :
+             v * powers_of_ten[exponent]);
+        *value = (negative ? -v : v);
+        return true;
+    }
+    
+    pthread_once(&c_locale_once, create_c_locale);
+    locale_t previous = uselocale(c_locale);
+    char *end;
+    errno = 0;
+    *value = strtod(str, &end);
+    bool overflow = (errno == ERANGE && isinf(*value));
+    uselocale(previous);
+    return *str && !*end && !overflow;
+}
+
+/*
+ * Same as parse_double(), but rounded once, straight to single precision,
+ * since rounding through a double first can be off by one unit.
+ */
+static bool parse_float(const char *str, float *value) {
+    static const float powers_of_ten[] = {
+        1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+    };
+    bool negative;
+    uint64_t mantissa;
+    int exponent;
+    if (scan_decimal(str, &negative, &mantissa, &exponent) &&
+        mantissa <= (UINT64_C(1) << 24) && exponent >= -10 && exponent <= 10) {
+        float v = (float)mantissa;
+        v = (exponent < 0 ? v / powers_of_ten[-exponent] :
+             v * powers_of_ten[exponent]);
+        *value = (negative ? -v : v);
+        return true;
+    }
+    
+    pthread_once(&c_locale_once, create_c_locale);
+    locale_t previous = uselocale(c_locale);
+    char *end;
+    errno = 0;
+    *value = strtof(str, &end);
+    bool overflow = (errno == ERANGE && isinf(*value));
+    uselocale(previous);
+    return *str && !*end && !overflow;
+}
+
+/*
+ * Write the shortest representation that parses back to the exact same value.
+ * Any decimal of up to DBL_DIG (FLT_DIG) significant digits survives a round
+ * trip through a normal double (float), and %g drops the trailing zeros, so
+ * the search starts there: at most three attempts for a double, four for a
+ * float. Subnormals have fewer significant bits and are searched from 1.
+ * Integers are written out in full, unless the exponent form is shorter.
+ */
+static void format_real(char *buf, double value, bool single) {
+    if (!isfinite(value)) {
+        snprintf(buf, NUMBER_BUFFER, "%g", value);
+        return;
+    }
+    pthread_once(&c_locale_once, create_c_locale);
+    locale_t previous = uselocale(c_locale);
+    bool subnormal = (value != 0 &&
+                      fabs(value) < (single ? FLT_MIN : DBL_MIN));
+    int max_precision = (single ? FLT_DECIMAL_DIG : DBL_DECIMAL_DIG);
+    int precision = (subnormal ? 1 : (single ? FLT_DIG : DBL_DIG));
+    for (; ; precision++) {
+        snprintf(buf, NUMBER_BUFFER, "%.*g", precision, value);
+        if (precision == max_precision) {
+            break;
+        }
+        double parsed;
+        if (single) {
+            float f;
+            if (parse_float(buf, &f) && f == (float)value) {
+                break;
+            }
+        } else if (parse_double(buf, &parsed) && parsed == value) {
+            break;
+        }
+    }
+    
+    if (fabs(value) < 1e15 && value == (double)(int64_t)value &&
+        !(value == 0 && signbit(value))) {
+        char integer[NUMBER_BUFFER];
+        int len = snprintf(integer, NUMBER_BUFFER, "%" PRId64, (int64_t)value);
+        int digits = len - (value < 0);
+        int zeros = 0;
+        while (zeros < digits - 1 && integer[len - 1 - zeros] == '0') {
+            zeros++;
+        }
+        if (zeros) {
+            // Round integers may be shorter in exponent form, such as 6e+05
+            char rounded[NUMBER_BUFFER];
+            snprintf(rounded, NUMBER_BUFFER, "%.*g", digits - zeros, value);
+            if (strlen(rounded) < strlen(buf)) {
+                strcpy(buf, rounded);
+            }
+        }
+        if (len <= (int)strlen(buf)) {
+            memcpy(buf, integer, len + 1);
+        }
+    }
+    uselocale(previous);
+}
+
+static void format_number(char *buf, CnVarType type, const CnVarValue *value) {
+    switch (type) {
+        case CVAR_INT:
+            snprintf(buf, NUMBER_BUFFER, "%d", value->i_val);
+            break;
+        case CVAR_INT64:
+            snprintf(buf, NUMBER_BUFFER, "%" PRId64, value->i64_val);
+            break;
+        case CVAR_FLOAT:
+            format_real(buf, value->f_val, true);
+            break;
+        case CVAR_DOUBLE:
+            format_real(buf, value->d_val, false);
+            break;
+        case CVAR_BOOL:
+        case CVAR_STRING:
+            buf[0] = 0;
+            break;
+    }
+}
+
+static void print_value(FILE *f, CnVarType type, const CnVarValue *value) {
+    char buf[NUMBER_BUFFER];
     switch (type) {
         case CVAR_BOOL:
             fprintf(f, "%s", (value->b_val ? "true" : "false"));
             break;
-        case CVAR_INT:
-            fprintf(f, "%d", (value->i_val));
-            break;
         case CVAR_STRING:
             fprintf(f, "%s", (value->str));
             break;
+        default:
+            format_number(buf, type, value);
+            fputs(buf, f);
+            break;
     }
 }
 
-static void repr_value(FILE *f, CnVarType type, CnVarValue *value) {
+static void repr_value(FILE *f, CnVarType type, const CnVarValue *value) {
+    char buf[NUMBER_BUFFER];
     switch (type) {
         case CVAR_BOOL:
             fprintf(f, "%s", (value->b_val ? "1" : "0"));
             break;
-        case CVAR_INT:
-            fprintf(f, "%d", (value->i_val));
-            break;
         case CVAR_STRING:
-            fprintf(f, "\"%s\"", (value->str));
+            // Quoted and escaped as expected by tokenize_statement()
+            fputc('"', f);
+            for (const char *c = value->str; *c; c++) {
+                if (*c == '"' || *c == '\\') {
+                    fputc('\\', f);
+                }
+                fputc(*c, f);
+            }
+            fputc('"', f);
             break;
+        default:
+            format_number(buf, type, value);
+            fputs(buf, f);
+            break;
+    }
+}
+
+static void describe_constraints(Console *con, const CnVariable *cvar) {
+    const CnVarConstraints *cons = cvar->constraints;
+    if (!cons) {
+        return;
+    }
+    if (cons->has_min || cons->has_max) {
+        fprintf(con->output, "\nRange: ");
+        if (cons->has_min) {
+            print_value(con->output, cvar->type, &cons->min);
+        }
+        fprintf(con->output, "..");
+        if (cons->has_max) {
+            print_value(con->output, cvar->type, &cons->max);
+        }
+    }
+    if (cons->t_allowed) {
+        fprintf(con->output, "\nAllowed:");
+        for (int i = 0; i < cons->t_allowed; i++) {
+            fprintf(con->output, " %s", cons->allowed[i]);
+        }
     }
 }
 
-static void describe_object(Console *con, CnNamespace *ns, CnObject *obj) {
+static void describe_object(Console *con, CnNamespace *ns,
+                            const CnObject *obj) {
     if (!ns || !obj) {
         return;
     }
@@ -67,16 +368,224 @@ static void describe_object(Console *con, CnNamespace *ns, CnObject *obj) {
                         &obj->sub.var.default_value);
             fprintf(con->output, "\nCurrent: ");
             print_value(con->output, obj->sub.var.type,
-                        &obj->sub.var.value);
+                        ns->values + obj->sub.var.slot);
+            describe_constraints(con, &obj->sub.var);
             fprintf(con->output, "\n%s\n", obj->description);
             break;
     }
 }
 
-static CnObject *resolve_object_name(Console *con, CnNamespace **return_ns,
-                                     const char *name) {
+static int edit_distance(const char *a, const char *b) {
+    size_t len_b = strlen(b);
+    int row[len_b + 1];
+    for (size_t j = 0; j <= len_b; j++) {
+        row[j] = (int)j;
+    }
+    for (int i = 1; *a; i++, a++) {
+        int diag = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= len_b; j++) {
+            int above = row[j];
+            int best = diag + (*a != b[j - 1]);
+            if (above + 1 < best) {
+                best = above + 1;
+            }
+            if (row[j - 1] + 1 < best) {
+                best = row[j - 1] + 1;
+            }
+            row[j] = best;
+            diag = above;
+        }
+    }
+    return row[len_b];
+}
+
+typedef struct CnSuggestion {
+    const char *ns_name;
+    const char *name;
+    int dist;
+} CnSuggestion;
+
+static void add_suggestion(CnSuggestion *best, int *n_best,
+                           const char *ns_name, const char *name, int dist) {
+    // Both trie searches may find the same name
+    for (int j = 0; j < *n_best; j++) {
+        if (best[j].name == name) {
+            return;
+        }
+    }
+    int i = *n_best;
+    if (i == CANARD_MAX_SUGGESTIONS) {
+        if (best[i - 1].dist <= dist) {
+            return;
+        }
+        i--;
+    } else {
+        (*n_best)++;
+    }
+    // Keep the list sorted by distance, ties in discovery order
+    for (; i > 0 && best[i - 1].dist > dist; i--) {
+        best[i] = best[i - 1];
+    }
+    best[i] = (CnSuggestion){ns_name, name, dist};
+}
+
+/*
+ * Walk a trie while computing one row of the Levenshtein matrix per node.
+ * By pigeonhole, a name within CANARD_SUGGEST_DISTANCE edits has at most half
+ * of them on one side of the query's midpoint. So two searches are made: over
+ * the names with the query's first half, and over the reversed names with the
+ * reversed query's first half; each allowing only half the edits in the
+ * first half of the query. A subtree is skipped once no cell of its row can
+ * still lead to a match, which keeps the bushy top of the trie unexplored.
+ */
+static void trie_search(const CnSchema *schema, const CnTrieNode *trie,
+                        int node, int depth, const char *name, int len,
+                        int split, const int *prev_row, CnSuggestion *best,
+                        int *n_best) {
+    // Cells further than the bound from the diagonal can never be within it,
+    // so only a band of the row is computed and the rest stays saturated
+    const int bound = CANARD_SUGGEST_DISTANCE;
+    int row[len + 1];
+    for (int j = 0; j <= len; j++) {
+        row[j] = bound + 1;
+    }
+    depth++;
+    int from = (depth - bound > 1 ? depth - bound : 1);
+    int to = (depth + bound < len ? depth + bound : len);
+    int end = trie[node].child + trie[node].t_children;
+    for (int child = trie[node].child; child < end; child++) {
+        char c = trie[child].c;
+        row[0] = (depth <= bound ? depth : bound + 1);
+        bool keep = (row[0] <= bound / 2);
+        for (int j = from; j <= to; j++) {
+            int dist = prev_row[j - 1] + (name[j - 1] != c);
+            if (prev_row[j] + 1 < dist) {
+                dist = prev_row[j] + 1;
+            }
+            if (row[j - 1] + 1 < dist) {
+                dist = row[j - 1] + 1;
+            }
+            row[j] = (dist <= bound ? dist : bound + 1);
+            keep |= (dist <= (j <= split ? bound / 2 : bound));
+        }
+        int obj = trie[child].obj;
+        if (obj >= 0 && row[len] <= bound) {
+            add_suggestion(best, n_best, schema->name,
+                           schema->objs[obj].name, row[len]);
+        }
+        if (keep) {
+            trie_search(schema, trie, child, depth, name, len, split, row,
+                        best, n_best);
+        }
+    }
+}
+
+/*
+ * Build a trie of the names (or of the names spelled backwards). Nodes are
+ * first linked through sibling lists, then laid out breadth-first so that the
+ * children of a node are contiguous.
+ */
+static CnTrieNode *trie_build(const CnSchema *schema, bool reversed,
+                              int *t_nodes) {
+    int capacity = schema->t_objs + 1;
+    CnTrieNode *linked = malloc_zeroed(sizeof(CnTrieNode) * capacity);
+    int *siblings = malloc_zeroed(sizeof(int) * capacity);
+    linked[0].obj = -1;
+    int total = 1;
+    for (int i = 0; i < schema->t_objs; i++) {
+        const char *name = schema->objs[i].name;
+        int len = (int)strlen(name);
+        int node = 0;
+        for (int k = 0; k < len; k++) {
+            char c = name[reversed ? len - 1 - k : k];
+            int child = linked[node].child;
+            while (child && linked[child].c != c) {
+                child = siblings[child];
+            }
+            if (!child) {
+                if (total == capacity) {
+                    capacity *= 2;
+                    linked = realloc(linked, sizeof(CnTrieNode) * capacity);
+                    siblings = realloc(siblings, sizeof(int) * capacity);
+                }
+                child = total++;
+                linked[child] = (CnTrieNode){0, 0, -1, c};
+                siblings[child] = linked[node].child;
+                linked[node].child = child;
+            }
+            node = child;
+        }
+        linked[node].obj = i;
+    }
+    
+    // Breadth-first order: order[i] is the linked node placed at index i
+    CnTrieNode *trie = malloc(sizeof(CnTrieNode) * total);
+    int *order = malloc(sizeof(int) * total);
+    order[0] = 0;
+    int placed = 1;
+    for (int i = 0; i < total; i++) {
+        const CnTrieNode *src = linked + order[i];
+        trie[i] = (CnTrieNode){placed, 0, src->obj, src->c};
+        for (int child = src->child; child; child = siblings[child]) {
+            order[placed++] = child;
+            trie[i].t_children++;
+        }
+    }
+    free(order);
+    free(siblings);
+    free(linked);
+    *t_nodes = total;
+    return trie;
+}
+
+/*
+ * Print the closest names to a mistyped one, either within a given namespace
+ * or qualified across all of them.
+ */
+static void suggest_names(Console *con, CnNamespace *ns, const char *name) {
+    CnSuggestion best[CANARD_MAX_SUGGESTIONS];
+    int n_best = 0;
+    int len = (int)strlen(name);
+    char reversed[len + 1];
+    int first_row[len + 1];
+    for (int j = 0; j <= len; j++) {
+        first_row[j] = (j <= CANARD_SUGGEST_DISTANCE ? j :
+                        CANARD_SUGGEST_DISTANCE + 1);
+        reversed[j] = (j < len ? name[len - 1 - j] : 0);
+    }
+    for (int i = 0; i < CANARD_MAX_NAMESPACES; i++) {
+        CnNamespace *candidate_ns = ns ? ns : con->nss + i;
+        if (!candidate_ns->name) {
+            break;
+        }
+        const CnSchema *schema = candidate_ns->schema;
+        trie_search(schema, schema->trie, 0, 0, name, len, len / 2,
+                    first_row, best, &n_best);
+        trie_search(schema, schema->rtrie, 0, 0, reversed, len,
+                    len - len / 2, first_row, best, &n_best);
+        if (ns) {
+            break;
+        }
+    }
+    if (n_best) {
+        fprintf(con->output, "Did you mean:\n");
+        for (int i = 0; i < n_best; i++) {
+            fprintf(con->output, "\t%s.%s\n", best[i].ns_name, best[i].name);
+        }
+    }
+}
+
+/*
+ * Resolve a possibly qualified name, printing the reason of any failure.
+ * A bare namespace name lists its objects; in that case only the namespace
+ * is returned through return_ns, which is NULL on any failure.
+ */
+static const CnObject *resolve_object_name(Console *con,
+                                           CnNamespace **return_ns,
+                                           const char *name) {
     CnNamespace *ns = NULL;
-    CnObject *obj = NULL;
+    const CnObject *obj = NULL;
     if (name) {
         char *s_name = strdup(name);
         char *post_dot = s_name;
@@ -89,27 +598,40 @@ static CnObject *resolve_object_name(Console *con, CnNamespace **return_ns,
                     fprintf(con->output, "%s: No such command or variable in "
                                          "namespace \"%s\"\n",
                             post_dot, s_name);
+                    suggest_names(con, ns, post_dot);
+                    ns = NULL;
                 }
             } else {
                 fprintf(con->output, "%s: No such namespace\n", s_name);
+                for (int i = 0; i < CANARD_MAX_NAMESPACES; i++) {
+                    if (!con->nss[i].name) {
+                        break;
+                    }
+                    if (edit_distance(s_name, con->nss[i].name) <=
+                        CANARD_SUGGEST_DISTANCE) {
+                        fprintf(con->output, "Did you mean: %s\n",
+                                con->nss[i].name);
+                    }
+                }
             }
         } else {
             CnNamespace *matches[CANARD_MAX_NAMESPACES];
             int n_matches = 0;
-            CnObject *candidate = NULL;
+            const CnObject *candidate = NULL;
             for (int i = 0; i < CANARD_MAX_NAMESPACES; i++) {
                 CnNamespace *candidate_ns = con->nss + i;
+                if (!candidate_ns->name) {
+                    break;
+                }
                 if (!strcmp(candidate_ns->name, name)) {
                     fprintf(con->output, "%s: namespace", name);
                     const char *labels[] = {"Commands", "Variables"};
                     for (int j = 0; j < 2; j++) {
                         fprintf(con->output, "\n\t%s:", labels[j]);
                         bool none = true;
-                        for (int k = 0; k < candidate_ns->t_objs; k++) {
-                            CnObject *obj = candidate_ns->objs + k;
-                            if (!obj->name) {
-                                break;
-                            }
+                        const CnSchema *schema = candidate_ns->schema;
+                        for (int k = 0; k < schema->t_objs; k++) {
+                            const CnObject *obj = schema->objs + k;
                             if (obj->type == j) {
                                 fprintf(con->output, " %s", obj->name);
                                 none = false;
@@ -124,7 +646,8 @@ static CnObject *resolve_object_name(Console *con, CnNamespace **return_ns,
                     ns = candidate_ns;
                     break;
                 }
-                CnObject *match = canard_find_object(candidate_ns, name);
+                const CnObject *match = canard_find_object(candidate_ns,
+                                                           name);
                 if (match) {
                     candidate = match;
                     matches[n_matches++] = candidate_ns;
@@ -136,6 +659,7 @@ static CnObject *resolve_object_name(Console *con, CnNamespace **return_ns,
                 case 0:
                     fprintf(con->output, "%s: No such command or variable\n",
                             name);
+                    suggest_names(con, NULL, name);
                     break;
                 case 1:
                     ns = matches[0];
@@ -159,21 +683,472 @@ static CnObject *resolve_object_name(Console *con, CnNamespace **return_ns,
     return obj;
 }
 
-static bool var_is_changed(CnVariable *cvar) {
-    switch (cvar->type) {
+static bool values_equal(CnVarType type, const CnVarValue *a,
+                         const CnVarValue *b) {
+    switch (type) {
         case CVAR_BOOL:
-            return cvar->default_value.b_val != cvar->value.b_val;
+            return a->b_val == b->b_val;
         case CVAR_INT:
-            return cvar->default_value.i_val != cvar->value.i_val;
+            return a->i_val == b->i_val;
         case CVAR_STRING:
-            return strcmp(cvar->default_value.str, cvar->value.str);
+            return a->str == b->str || !strcmp(a->str, b->str);
+        case CVAR_INT64:
+            return a->i64_val == b->i64_val;
+        case CVAR_FLOAT:
+            // NaN is never equal to itself, but it is the same setting
+            return (a->f_val == b->f_val ||
+                    (isnan(a->f_val) && isnan(b->f_val)));
+        case CVAR_DOUBLE:
+            return (a->d_val == b->d_val ||
+                    (isnan(a->d_val) && isnan(b->d_val)));
     }
     return false;
 }
 
-static void handle_cvar_change(Console *con, CnObject *obj) {
-    if (obj->sub.var.func) {
-        (*obj->sub.var.func)(obj->ns->handler, con, &obj->sub.var.value);
+static bool var_is_changed(CnNamespace *ns, const CnVariable *cvar) {
+    return !values_equal(cvar->type, &cvar->default_value,
+                         ns->values + cvar->slot);
+}
+
+static uint32_t hash_string(uint32_t seed, const char *str) {
+    // FNV-1a, with the seed folded into the offset basis
+    uint32_t hash = 2166136261u ^ seed;
+    for (; *str; str++) {
+        hash ^= (uint8_t)*str;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Find a seed and table size for which the allowed values of a string cvar
+ * hash without collision, so that a lookup is one hash and one strcmp().
+ */
+static void build_allowed_hash(CnVarConstraints *cons) {
+    int t_slots = 2;
+    while (t_slots < cons->t_allowed * 2) {
+        t_slots *= 2;
+    }
+    for (;; t_slots *= 2) {
+        cons->slots = realloc(cons->slots, sizeof(int) * t_slots);
+        for (uint32_t seed = 0; seed < 64; seed++) {
+            memset(cons->slots, -1, sizeof(int) * t_slots);
+            bool collision = false;
+            for (int i = 0; i < cons->t_allowed && !collision; i++) {
+                uint32_t h = hash_string(seed, cons->allowed[i]) &
+                             (t_slots - 1);
+                if (cons->slots[h] >= 0) {
+                    // Listing the same value twice is not a collision
+                    collision = strcmp(cons->allowed[cons->slots[h]],
+                                       cons->allowed[i]);
+                }
+                cons->slots[h] = i;
+            }
+            if (!collision) {
+                cons->seed = seed;
+                cons->slot_mask = t_slots - 1;
+                return;
+            }
+        }
+    }
+}
+
+static bool is_allowed(const CnVarConstraints *cons, const char *str) {
+    int i = cons->slots[hash_string(cons->seed, str) & cons->slot_mask];
+    return i >= 0 && !strcmp(cons->allowed[i], str);
+}
+
+static CnVarConstraints *create_constraints(const CnVarDecl *decl) {
+    if (!decl->min && !decl->max && !(decl->allowed &&
+                                      decl->type == CVAR_STRING)) {
+        return NULL;
+    }
+    CnVarConstraints *cons = malloc_zeroed(sizeof(CnVarConstraints));
+    const void *bounds[] = {decl->min, decl->max};
+    CnVarValue *values[] = {&cons->min, &cons->max};
+    bool *flags[] = {&cons->has_min, &cons->has_max};
+    for (int i = 0; i < 2; i++) {
+        if (!bounds[i]) {
+            continue;
+        }
+        switch (decl->type) {
+            case CVAR_INT:
+                values[i]->i_val = *(int *)bounds[i];
+                break;
+            case CVAR_INT64:
+                values[i]->i64_val = *(int64_t *)bounds[i];
+                break;
+            case CVAR_FLOAT:
+                values[i]->f_val = *(float *)bounds[i];
+                break;
+            case CVAR_DOUBLE:
+                values[i]->d_val = *(double *)bounds[i];
+                break;
+            case CVAR_BOOL:
+            case CVAR_STRING:
+                continue;
+        }
+        *flags[i] = true;
+    }
+    if (decl->allowed && decl->type == CVAR_STRING) {
+        while (decl->allowed[cons->t_allowed]) {
+            cons->t_allowed++;
+        }
+        cons->allowed = decl->allowed;
+        build_allowed_hash(cons);
+    }
+    return cons;
+}
+
+static void destroy_constraints(CnVarConstraints *cons) {
+    if (cons) {
+        free(cons->slots);
+        free(cons);
+    }
+}
+
+static bool value_is_valid(const CnVariable *cvar, const CnVarValue *value) {
+    const CnVarConstraints *cons = cvar->constraints;
+    if (cvar->type == CVAR_STRING) {
+        return value->str && (!cons || !cons->t_allowed ||
+                              is_allowed(cons, value->str));
+    }
+    if (!cons) {
+        return true;
+    }
+    // Written so that NaN is rejected by any bound
+    switch (cvar->type) {
+        case CVAR_INT:
+            return ((!cons->has_min || value->i_val >= cons->min.i_val) &&
+                    (!cons->has_max || value->i_val <= cons->max.i_val));
+        case CVAR_INT64:
+            return ((!cons->has_min || value->i64_val >= cons->min.i64_val) &&
+                    (!cons->has_max || value->i64_val <= cons->max.i64_val));
+        case CVAR_FLOAT:
+            return ((!cons->has_min || value->f_val >= cons->min.f_val) &&
+                    (!cons->has_max || value->f_val <= cons->max.f_val));
+        case CVAR_DOUBLE:
+            return ((!cons->has_min || value->d_val >= cons->min.d_val) &&
+                    (!cons->has_max || value->d_val <= cons->max.d_val));
+        case CVAR_BOOL:
+        case CVAR_STRING:
+            break;
+    }
+    return true;
+}
+
+/*
+ * Constraints must fit the variable's type, and each bound as well as the
+ * default value must satisfy them, which also rules out min > max and NaN.
+ */
+static bool var_decl_is_valid(const CnVarDecl *decl,
+                              const CnVariable *cvar) {
+    if ((decl->min || decl->max) &&
+        (decl->type == CVAR_BOOL || decl->type == CVAR_STRING)) {
+        return false;
+    }
+    if (decl->allowed && decl->type != CVAR_STRING) {
+        return false;
+    }
+    const CnVarConstraints *cons = cvar->constraints;
+    if (cons && ((cons->has_min && !value_is_valid(cvar, &cons->min)) ||
+                 (cons->has_max && !value_is_valid(cvar, &cons->max)))) {
+        return false;
+    }
+    return value_is_valid(cvar, &cvar->default_value);
+}
+
+static void retire_string(CnRetiredStrings *retired, char *str) {
+    if (retired->count == retired->capacity) {
+        retired->capacity = (retired->capacity ? retired->capacity * 2 : 8);
+        retired->strs = realloc(retired->strs,
+                                sizeof(char *) * retired->capacity);
+    }
+    retired->strs[retired->count++] = str;
+}
+
+static void free_retired(CnRetiredStrings *retired) {
+    for (int i = 0; i < retired->count; i++) {
+        free(retired->strs[i]);
+    }
+    retired->count = 0;
+}
+
+static void store_value(Console *con, const CnVariable *cvar,
+                        CnVarValue *current, CnVarValue value) {
+    if (cvar->type != CVAR_STRING) {
+        *current = value;
+        return;
+    }
+    // Strings are shared with the schema until first changed, and a reader
+    // may still be copying the old one, so it is only freed later on
+    if (current->str != cvar->default_value.str) {
+        retire_string(&con->retired, current->str);
+    }
+    if (!strcmp(cvar->default_value.str, value.str)) {
+        current->str = cvar->default_value.str;
+    } else {
+        current->str = strdup(value.str);
+    }
+}
+
+/*
+ * Variable writes are published under a seqlock: the generation counter is
+ * odd while values are being written, and advanced by two per publication.
+ * Replaced strings are freed once a publication ends with no reader in
+ * progress. A reader registers before loading any value, and the fences
+ * order that against the writer's check: either the writer sees the reader,
+ * or the reader sees the new values and never loads a retired string.
+ */
+static void publish_begin(Console *con) {
+    atomic_fetch_add_explicit(&con->generation, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void publish_end(Console *con) {
+    atomic_fetch_add_explicit(&con->generation, 1, memory_order_release);
+    if (con->retired.count) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!atomic_load_explicit(&con->readers, memory_order_acquire)) {
+            free_retired(&con->retired);
+        }
+    }
+}
+
+static void free_staged(CnStagedValue *staged, int count) {
+    for (int i = 0; i < count; i++) {
+        if (staged[i].cvar->type == CVAR_STRING) {
+            free(staged[i].value.str);
+        }
+    }
+    free(staged);
+}
+
+static void stage_value(CnTransaction *txn, CnNamespace *ns,
+                        const CnVariable *cvar, CnVarValue value) {
+    if (cvar->type == CVAR_STRING) {
+        value.str = strdup(value.str);
+    }
+    for (int i = 0; i < txn->count; i++) {
+        CnStagedValue *entry = txn->staged + i;
+        if (entry->ns == ns && entry->cvar == cvar) {
+            if (cvar->type == CVAR_STRING) {
+                free(entry->value.str);
+            }
+            entry->value = value;
+            return;
+        }
+    }
+    if (txn->count == txn->capacity) {
+        txn->capacity = (txn->capacity ? txn->capacity * 2 : 8);
+        txn->staged = realloc(txn->staged,
+                              sizeof(CnStagedValue) * txn->capacity);
+    }
+    txn->staged[txn->count++] = (CnStagedValue){ns, cvar, value, false};
+}
+
+static void handle_cvar_change(Console *con, CnNamespace *ns,
+                               const CnVariable *cvar) {
+    if (cvar->func && ns->handler) {
+        (*cvar->func)(ns->handler, con, ns->values + cvar->slot);
+    }
+}
+
+/*
+ * Reject a set. Inside a transaction, this also fails the commit, so that
+ * the batch is never published in part.
+ */
+static bool reject_set(Console *con) {
+    if (con->txn.active) {
+        con->txn.failed = true;
+    }
+    return false;
+}
+
+static bool set_cvar_value(Console *con, CnNamespace *ns,
+                           const CnVariable *cvar, CnVarValue value) {
+    if (!value_is_valid(cvar, &value)) {
+        return reject_set(con);
+    }
+    if (con->txn.active) {
+        stage_value(&con->txn, ns, cvar, value);
+        return true;
+    }
+    CnVarValue *current = ns->values + cvar->slot;
+    if (values_equal(cvar->type, current, &value)) {
+        return true;
+    }
+    publish_begin(con);
+    store_value(con, cvar, current, value);
+    publish_end(con);
+    handle_cvar_change(con, ns, cvar);
+    return true;
+}
+
+static bool is_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*
+ * Split the raw statement into arguments, in place. Double quotes group
+ * separators into a single argument, and inside them a backslash escapes the
+ * next character.
+ */
+static void tokenize_statement(CnStatement *stat) {
+    char *p = stat->raw;
+    stat->argc = 0;
+    while (stat->argc < CANARD_MAX_ARGS) {
+        while (is_separator(*p)) {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        char *out = p;
+        stat->argv[stat->argc++] = out;
+        bool quoted = false;
+        while (*p && (quoted || !is_separator(*p))) {
+            if (*p == '"') {
+                quoted = !quoted;
+                p++;
+                continue;
+            }
+            if (quoted && *p == '\\' && p[1]) {
+                p++;
+            }
+            *out++ = *p++;
+        }
+        if (*p) {
+            p++;
+        }
+        *out = 0;
+    }
+}
+
+static bool parse_bool(const char *str, bool *value) {
+    const char *truthy[] = {"1", "true", "yes", "on"};
+    const char *falsy[] = {"0", "false", "no", "off"};
+    for (int i = 0; i < 4; i++) {
+        if (!strcasecmp(str, truthy[i])) {
+            *value = true;
+            return true;
+        }
+        if (!strcasecmp(str, falsy[i])) {
+            *value = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_cvar_value(const CnVariable *cvar, const char *str,
+                             CnVarValue *value) {
+    switch (cvar->type) {
+        case CVAR_BOOL:
+            return parse_bool(str, &value->b_val);
+        case CVAR_INT: {
+            int64_t parsed;
+            if (!parse_int64(str, &parsed) || parsed < INT_MIN ||
+                parsed > INT_MAX) {
+                return false;
+            }
+            value->i_val = (int)parsed;
+            return true;
+        }
+        case CVAR_INT64:
+            return parse_int64(str, &value->i64_val);
+        case CVAR_FLOAT:
+            return parse_float(str, &value->f_val);
+        case CVAR_DOUBLE:
+            return parse_double(str, &value->d_val);
+        case CVAR_STRING:
+            value->str = (char *)str;
+            return true;
+    }
+    return false;
+}
+
+/*
+ * Keep a command for when the namespace gets a handler. The arguments point
+ * into the statement's own raw buffer, so they are rebased on the copy.
+ */
+static bool buffer_statement(Console *con, CnNamespace *ns,
+                             const CnStatement *stat) {
+    if (ns->t_buffered == CANARD_MAX_BUFFER) {
+        fprintf(con->output, "%s: Too many commands awaiting a handler\n",
+                stat->argv[0]);
+        return false;
+    }
+    if (!ns->buffer) {
+        ns->buffer = malloc(sizeof(CnStatement) * CANARD_MAX_BUFFER);
+    }
+    CnStatement *copy = ns->buffer + ns->t_buffered++;
+    memcpy(copy->raw, stat->raw, CANARD_MAX_CMDLINE);
+    copy->argc = stat->argc;
+    for (int i = 0; i < stat->argc; i++) {
+        copy->argv[i] = copy->raw + (stat->argv[i] - stat->raw);
+    }
+    return true;
+}
+
+static bool exec_object(Console *con, CnNamespace *ns, const CnObject *obj,
+                        const CnStatement *stat) {
+    switch (obj->type) {
+        case COBJ_CMD:
+            if (obj->sub.cmd.func && !ns->handler) {
+                return buffer_statement(con, ns, stat);
+            }
+            if (obj->sub.cmd.func &&
+                !(*obj->sub.cmd.func)(ns->handler, con, stat)) {
+                fprintf(con->output, "Usage: ");
+                describe_object(con, ns, obj);
+                return false;
+            }
+            return true;
+        case COBJ_VAR: {
+            const CnVariable *cvar = &obj->sub.var;
+            CnVarValue value;
+            if (stat->argc == 1) {
+                describe_object(con, ns, obj);
+            } else if (!parse_cvar_value(cvar, stat->argv[1], &value)) {
+                fprintf(con->output, "%s: Invalid %s value \"%s\"\n",
+                        stat->argv[0], cvar_type_names[cvar->type],
+                        stat->argv[1]);
+                return reject_set(con);
+            } else if (!set_cvar_value(con, ns, cvar, value)) {
+                fprintf(con->output, "%s: Value \"%s\" is not allowed",
+                        stat->argv[0], stat->argv[1]);
+                describe_constraints(con, cvar);
+                fputc('\n', con->output);
+                return false;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static int compare_object_names(const void *a, const void *b) {
+    return strcmp((*(const CnObject **)a)->name,
+                  (*(const CnObject **)b)->name);
+}
+
+static int compare_name_to_object(const void *key, const void *elem) {
+    return strcmp((const char *)key, (*(const CnObject **)elem)->name);
+}
+
+#define EXEC_READ_SIZE (1 << 20)
+
+static void exec_line(Console *con, CnRunStats *stats, char *line) {
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    if (!*line || *line == '#' || *line == '\r') {
+        return;
+    }
+    stats->statements++;
+    if (!canard_exec(con, line)) {
+        stats->errors++;
     }
 }
 
@@ -192,7 +1167,8 @@ static bool cmd_help(void *handler, Console *con, const CnStatement *stat) {
     } else {
         for (int i = 1; i < stat->argc; i++) {
             CnNamespace *ns = NULL;
-            CnObject *obj = resolve_object_name(con, &ns, stat->argv[i]);
+            const CnObject *obj = resolve_object_name(con, &ns,
+                                                      stat->argv[i]);
             if (obj) {
                 describe_object(con, ns, obj);
             }
@@ -224,9 +1200,9 @@ static bool cmd_save(void *handler, Console *con, const CnStatement *stat) {
     if (stat->argc != 2) {
         return false;
     }
-    const char *save_path = canard_find_object(con->nss,
-                                               "save_path")->sub.var.value.str;
-    char full_path[strlen(save_path) + strlen(stat->argv[1]) + 1];
+    const char *save_path = canard_get_cvar_str(con->nss,
+        &canard_find_object(con->nss, "save_path")->sub.var);
+    char full_path[strlen(save_path) + strlen(stat->argv[1]) + 2];
     strcpy(full_path, save_path);
     strcat(full_path, "/");
     strcat(full_path, stat->argv[1]);
@@ -237,16 +1213,13 @@ static bool cmd_save(void *handler, Console *con, const CnStatement *stat) {
             if (!ns->name) {
                 break;
             }
-            for (int j = 0; j < ns->t_objs; j++) {
-                CnObject *obj = ns->objs + j;
-                if (obj->type != COBJ_VAR) {
-                    continue;
-                }
-                if (!var_is_changed(&obj->sub.var)) {
+            for (int j = 0; j < ns->schema->t_vars; j++) {
+                const CnObject *obj = ns->schema->objs + j;
+                if (!var_is_changed(ns, &obj->sub.var)) {
                     continue;
                 }
                 fprintf(f, "%s.%s ", ns->name, obj->name);
-                repr_value(f, obj->sub.var.type, &obj->sub.var.value);
+                repr_value(f, obj->sub.var.type, ns->values + j);
                 fprintf(f, "\n");
             }
         }
@@ -280,6 +1253,185 @@ const CnVarDecl builtin_vars[] = {
     END_VAR_DECL
 };
 
+static CnSchema *builtin_schema;
+static pthread_once_t builtin_schema_once = PTHREAD_ONCE_INIT;
+
+static void create_builtin_schema(void) {
+    builtin_schema = canard_create_schema("console", builtin_cmds,
+                                          builtin_vars);
+}
+
+// JOURNAL //
+
+#define JOURNAL_MAGIC 0x4a4e4443 /* "CDNJ" */
+#define JOURNAL_VERSION 3
+#define JOURNAL_PAD 0xffff
+#define JOURNAL_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+/*
+ * A journal file is a header followed by a ring of 8-byte aligned records.
+ * head and tail are ever-increasing byte positions; a record lives at
+ * position % capacity in the ring. A record that would straddle the end of
+ * the ring is preceded by a padding record filling the remaining space.
+ * A statement record holds the NUL-terminated arguments, followed by the
+ * NUL-terminated name of the namespace the statement was resolved in.
+ */
+typedef struct CnJournalHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    uint64_t head;
+    uint64_t tail;
+} CnJournalHeader;
+
+#if CANARD_MAX_CMDLINE > 0xffff
+#error "Journal records store CANARD_MAX_CMDLINE in 16 bits"
+#endif
+
+typedef struct CnJournalRecord {
+    uint32_t size;
+    uint32_t obj_id;
+    uint64_t timestamp;
+    uint16_t ns_id;
+    uint16_t argc;
+    uint16_t ns_name_len;
+    uint16_t args_len;
+} CnJournalRecord;
+
+struct CnJournal {
+    CnJournalHeader *header;
+    uint8_t *ring;
+    size_t map_size;
+};
+
+static uint64_t journal_timestamp(void) {
+    // Served from the vDSO/commpage, this does not enter the kernel
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static CnJournalRecord *journal_record_at(CnJournalHeader *header,
+                                          uint8_t *ring, uint64_t pos) {
+    return (CnJournalRecord *)(ring + pos % header->capacity);
+}
+
+static bool journal_header_is_valid(const CnJournalHeader *header,
+                                    uint64_t file_size) {
+    return (header->magic == JOURNAL_MAGIC &&
+            header->version == JOURNAL_VERSION &&
+            header->capacity && header->capacity % 8 == 0 &&
+            sizeof(CnJournalHeader) + header->capacity <= file_size &&
+            header->head >= header->tail &&
+            header->head - header->tail <= header->capacity);
+}
+
+/*
+ * A record must be aligned, fit in the ring without wrapping around, and be
+ * large enough for its header unless it is padding.
+ */
+static bool journal_record_is_valid(const CnJournalHeader *header,
+                                    const CnJournalRecord *rec, uint64_t pos) {
+    return (rec->size >= 8 && rec->size % 8 == 0 &&
+            pos % header->capacity + rec->size <= header->capacity &&
+            (rec->ns_id == JOURNAL_PAD ||
+             rec->size >= sizeof(CnJournalRecord)));
+}
+
+/*
+ * Drop every record from the first invalid one on, so that the ring can
+ * always be walked from tail to head.
+ */
+static void journal_recover(CnJournal *journal) {
+    CnJournalHeader *header = journal->header;
+    uint64_t pos = header->tail;
+    while (pos < header->head) {
+        const CnJournalRecord *rec = journal_record_at(header, journal->ring,
+                                                       pos);
+        if (!journal_record_is_valid(header, rec, pos) ||
+            pos + rec->size > header->head) {
+            break;
+        }
+        pos += rec->size;
+    }
+    header->head = pos;
+}
+
+static void journal_reserve(CnJournal *journal, uint64_t end) {
+    CnJournalHeader *header = journal->header;
+    while (end - header->tail > header->capacity) {
+        header->tail += journal_record_at(header, journal->ring,
+                                          header->tail)->size;
+    }
+}
+
+static void journal_append(CnJournal *journal, int ns_id, const char *ns_name,
+                           int obj_id, const CnStatement *stat) {
+    CnJournalHeader *header = journal->header;
+    uint32_t args_len = 0;
+    for (int i = 0; i < stat->argc; i++) {
+        args_len += strlen(stat->argv[i]) + 1;
+    }
+    size_t ns_name_len = strlen(ns_name);
+    uint64_t size = JOURNAL_ALIGN(sizeof(CnJournalRecord) + args_len +
+                                  ns_name_len + 1);
+    if (ns_name_len > 0xffff || size > header->capacity) {
+        return;
+    }
+    
+    uint64_t pos = header->head;
+    uint64_t room = header->capacity - pos % header->capacity;
+    if (room < size) {
+        journal_reserve(journal, pos + room);
+        CnJournalRecord *pad = journal_record_at(header, journal->ring, pos);
+        pad->size = (uint32_t)room;
+        pad->ns_id = JOURNAL_PAD;
+        pos += room;
+        header->head = pos;
+    }
+    journal_reserve(journal, pos + size);
+    
+    CnJournalRecord *rec = journal_record_at(header, journal->ring, pos);
+    rec->size = (uint32_t)size;
+    rec->ns_id = (uint16_t)ns_id;
+    rec->obj_id = (uint32_t)obj_id;
+    rec->timestamp = journal_timestamp();
+    rec->argc = (uint16_t)stat->argc;
+    rec->ns_name_len = (uint16_t)ns_name_len;
+    rec->args_len = (uint16_t)args_len;
+    char *args = (char *)(rec + 1);
+    for (int i = 0; i < stat->argc; i++) {
+        size_t len = strlen(stat->argv[i]) + 1;
+        memcpy(args, stat->argv[i], len);
+        args += len;
+    }
+    memcpy(args, ns_name, ns_name_len + 1);
+    header->head = pos + size;
+}
+
+static bool journal_read_statement(const CnJournalRecord *rec,
+                                   CnStatement *stat, const char **ns_name) {
+    if (rec->argc < 1 || rec->argc > CANARD_MAX_ARGS ||
+        rec->args_len < 1 || rec->args_len > CANARD_MAX_CMDLINE ||
+        sizeof(CnJournalRecord) + rec->args_len + rec->ns_name_len + 1 >
+        rec->size) {
+        return false;
+    }
+    *ns_name = (const char *)(rec + 1) + rec->args_len;
+    if ((*ns_name)[rec->ns_name_len]) {
+        return false;
+    }
+    memcpy(stat->raw, rec + 1, rec->args_len);
+    stat->argc = 0;
+    char *arg = stat->raw;
+    char *end = stat->raw + rec->args_len;
+    while (arg < end && stat->argc < (int)rec->argc) {
+        stat->argv[stat->argc++] = arg;
+        arg += strnlen(arg, end - arg) + 1;
+    }
+    return stat->argc == (int)rec->argc && end[-1] == 0;
+}
+
 // PUBLIC FUNCTIONS //
 
 void canard_init(Console *con, const char *app_name) {
@@ -291,193 +1443,614 @@ void canard_init(Console *con, const char *app_name) {
     con->app_name = app_name;
     
     con->output = stdout;
+    atomic_init(&con->generation, 0);
+    atomic_init(&con->readers, 0);
     
-    CnNamespace *ns = canard_create_namespace(con, "console", builtin_cmds,
-                                              builtin_vars);
+    pthread_once(&builtin_schema_once, create_builtin_schema);
+    CnNamespace *ns = canard_attach_namespace(con, builtin_schema);
     canard_namespace_set_handler(ns, con);
 }
 
 void canard_teardown(Console *con) {
-    // Free all string cvars
+    canard_rollback(con);
     for (int i = 0; i < CANARD_MAX_NAMESPACES; i++) {
         CnNamespace *ns = con->nss + i;
         if (!ns->name) {
             break;
         }
-        for (int j = 0; j < ns->t_objs; j++) {
-            CnObject *obj = ns->objs + j;
-            if (obj->type == COBJ_VAR && obj->sub.var.type == CVAR_STRING) {
-                free(ns->objs->sub.var.default_value.str);
-                free(ns->objs->sub.var.value.str);
+        // Free all string cvars that were copied on write
+        for (int j = 0; j < ns->schema->t_vars; j++) {
+            const CnVariable *cvar = &ns->schema->objs[j].sub.var;
+            if (cvar->type == CVAR_STRING &&
+                ns->values[j].str != cvar->default_value.str) {
+                free(ns->values[j].str);
             }
         }
+        free(ns->values);
+        free(ns->buffer);
+        if (ns->owned_schema) {
+            canard_destroy_schema(ns->owned_schema);
+        }
     }
+    memset(con->nss, 0, sizeof(con->nss));
+    free_retired(&con->retired);
+    free(con->retired.strs);
+    memset(&con->retired, 0, sizeof(CnRetiredStrings));
+    canard_journal_close(con);
 }
 
-CnNamespace *canard_create_namespace(Console *con, const char *name,
-                                     const CnCmdDecl *cmds,
-                                     const CnVarDecl *vars) {
+CnSchema *canard_create_schema(const char *name, const CnCmdDecl *cmds,
+                               const CnVarDecl *vars) {
     if (!name) {
         return NULL;
     }
     
     // Count total sum of commands and variables
-    int total = 0;
+    int t_cmds = 0;
+    int t_vars = 0;
     if (cmds) {
-        const CnCmdDecl *decl = cmds;
-        while (decl->name) {
-            total++;
-            decl++;
+        while (cmds[t_cmds].name) {
+            t_cmds++;
         }
     }
     if (vars) {
-        const CnVarDecl *decl = vars;
-        while (decl->name) {
-            total++;
-            decl++;
+        while (vars[t_vars].name) {
+            t_vars++;
         }
     }
+    int total = t_cmds + t_vars;
     if (!total) {
         return NULL;
     }
-        
+    
+    CnSchema *schema = malloc_zeroed(sizeof(CnSchema));
+    schema->name = name;
+    schema->t_objs = total;
+    schema->t_vars = t_vars;
+    schema->objs = malloc_zeroed(sizeof(CnObject) * total);
+    schema->index = malloc(sizeof(CnObject *) * total);
+    
+    // Variables come first, so that a variable's slot is also its object index
+    CnObject *obj = schema->objs;
+    for (int i = 0; i < t_vars; i++) {
+        const CnVarDecl *decl = vars + i;
+        obj->name = decl->name;
+        obj->description = (decl->description ? decl->description :
+                            "No help available");
+        obj->type = COBJ_VAR;
+        obj->sub.var.func = decl->func;
+        obj->sub.var.type = decl->type;
+        obj->sub.var.slot = i;
+        obj->sub.var.constraints = create_constraints(decl);
+        switch (decl->type) {
+            case CVAR_BOOL:
+                if (decl->default_value) {
+                    obj->sub.var.default_value.b_val =
+                        *(bool *)decl->default_value;
+                }
+                break;
+            case CVAR_INT:
+                if (decl->default_value) {
+                    obj->sub.var.default_value.i_val =
+                        *(int *)decl->default_value;
+                }
+                break;
+            case CVAR_STRING:
+                obj->sub.var.default_value.str =
+                    strdup(decl->default_value ?
+                           (const char *)decl->default_value : "");
+                break;
+            case CVAR_INT64:
+                if (decl->default_value) {
+                    obj->sub.var.default_value.i64_val =
+                        *(int64_t *)decl->default_value;
+                }
+                break;
+            case CVAR_FLOAT:
+                if (decl->default_value) {
+                    obj->sub.var.default_value.f_val =
+                        *(float *)decl->default_value;
+                }
+                break;
+            case CVAR_DOUBLE:
+                if (decl->default_value) {
+                    obj->sub.var.default_value.d_val =
+                        *(double *)decl->default_value;
+                }
+                break;
+        }
+        if (!var_decl_is_valid(decl, &obj->sub.var)) {
+            canard_destroy_schema(schema);
+            return NULL;
+        }
+        obj++;
+    }
+    for (int i = 0; i < t_cmds; i++) {
+        const CnCmdDecl *decl = cmds + i;
+        obj->name = decl->name;
+        obj->description = decl->description;
+        obj->type = COBJ_CMD;
+        obj->sub.cmd.func = decl->func;
+        obj++;
+    }
+    
+    for (int i = 0; i < total; i++) {
+        schema->index[i] = schema->objs + i;
+    }
+    qsort(schema->index, total, sizeof(CnObject *), compare_object_names);
+    for (int i = 1; i < total; i++) {
+        if (!strcmp(schema->index[i - 1]->name, schema->index[i]->name)) {
+            canard_destroy_schema(schema);
+            return NULL;
+        }
+    }
+    schema->trie = trie_build(schema, false, &schema->t_trie);
+    schema->rtrie = trie_build(schema, true, &schema->t_rtrie);
+    
+    return schema;
+}
+
+void canard_destroy_schema(CnSchema *schema) {
+    if (!schema) {
+        return;
+    }
+    for (int i = 0; i < schema->t_vars; i++) {
+        if (schema->objs[i].sub.var.type == CVAR_STRING) {
+            free(schema->objs[i].sub.var.default_value.str);
+        }
+        destroy_constraints(
+            (CnVarConstraints *)schema->objs[i].sub.var.constraints);
+    }
+    free(schema->trie);
+    free(schema->rtrie);
+    free(schema->index);
+    free(schema->objs);
+    free(schema);
+}
+
+CnNamespace *canard_attach_namespace(Console *con, const CnSchema *schema) {
+    if (!schema) {
+        return NULL;
+    }
     for (int i = 0; i < CANARD_MAX_NAMESPACES; i++) {
         CnNamespace *ns = con->nss + i;
         if (!ns->name) {
-            ns->name = name;
-            ns->t_objs = total;
-            ns->objs = malloc_zeroed(sizeof(CnObject) * total);
-            CnObject *obj = ns->objs;
-            if (vars) {
-                const CnVarDecl *decl = vars;
-                while (decl->name) {
-                    obj->name = decl->name;
-                    obj->description = (decl->description ? decl->description :
-                                        "No help available");
-                    obj->type = COBJ_VAR;
-                    obj->sub.var.func = decl->func;
-                    obj->sub.var.type = decl->type;
-                    obj->ns = ns;
-                    if (decl->default_value) {
-                        switch (decl->type) {
-                            case CVAR_BOOL:
-                                obj->sub.var.default_value.b_val =
-                                    *(bool *)decl->default_value;
-                                break;
-                            case CVAR_INT:
-                                obj->sub.var.default_value.i_val =
-                                    *(int *)decl->default_value;
-                                break;
-                            case CVAR_STRING:
-                                obj->sub.var.default_value.str =
-                                    strdup((char *)decl->default_value);
-                                obj->sub.var.value.str =
-                                    strdup((char *)decl->default_value);
-                                break;
-                        }
-                        if (decl->type != CVAR_STRING) {
-                            obj->sub.var.value = obj->sub.var.default_value;
-                        }
-                    }
-                    obj++;
-                    decl++;
-                }
-            }
-            if (cmds) {
-                const CnCmdDecl *decl = cmds;
-                while (decl->name) {
-                    obj->name = decl->name;
-                    obj->description = decl->description;
-                    obj->type = COBJ_CMD;
-                    obj->sub.cmd.func = decl->func;
-                    obj++;
-                    decl++;
-                }
+            ns->con = con;
+            ns->name = schema->name;
+            ns->schema = schema;
+            ns->values = malloc(sizeof(CnVarValue) * (schema->t_vars ?
+                                                      schema->t_vars : 1));
+            for (int j = 0; j < schema->t_vars; j++) {
+                ns->values[j] = schema->objs[j].sub.var.default_value;
             }
             return ns;
         }
-        if (!strcmp(ns->name, name)) {
+        if (!strcmp(ns->name, schema->name)) {
             break;
         }
     }
     return NULL;
 }
 
+CnNamespace *canard_create_namespace(Console *con, const char *name,
+                                     const CnCmdDecl *cmds,
+                                     const CnVarDecl *vars) {
+    CnSchema *schema = canard_create_schema(name, cmds, vars);
+    CnNamespace *ns = canard_attach_namespace(con, schema);
+    if (ns) {
+        ns->owned_schema = schema;
+    } else {
+        canard_destroy_schema(schema);
+    }
+    return ns;
+}
+
 void canard_namespace_set_handler(CnNamespace *ns, void *handler) {
     ns->handler = handler;
+    if (!handler || !ns->buffer) {
+        return;
+    }
+    // Detach the buffer first, so that the commands may buffer anew
+    CnStatement *buffer = ns->buffer;
+    int t_buffered = ns->t_buffered;
+    ns->buffer = NULL;
+    ns->t_buffered = 0;
+    for (int i = 0; i < t_buffered; i++) {
+        CnStatement *stat = buffer + i;
+        const char *dot = strchr(stat->argv[0], '.');
+        const CnObject *obj = canard_find_object(ns, (dot ? dot + 1 :
+                                                      stat->argv[0]));
+        if (obj) {
+            exec_object(ns->con, ns, obj, stat);
+        }
+    }
+    free(buffer);
 }
 
-void canard_exec(Console *con, const char *cmdline) {
+bool canard_exec(Console *con, const char *cmdline) {
     CnStatement stat;
-    strncpy(stat.raw, cmdline, CANARD_MAX_CMDLINE);
-    stat.raw[CANARD_MAX_CMDLINE - 1] = 0;
-    char *sep = stat.raw;
-    do {
-        char *arg = strsep(&sep, " ");
-        if (!sep) {
+    if (strnlen(cmdline, CANARD_MAX_CMDLINE) == CANARD_MAX_CMDLINE) {
+        fprintf(con->output, "Statement is longer than %d characters\n",
+                CANARD_MAX_CMDLINE - 1);
+        return false;
+    }
+    strcpy(stat.raw, cmdline);
+    tokenize_statement(&stat);
+    if (!stat.argc) {
+        return true;
+    }
+    CnNamespace *ns = NULL;
+    const CnObject *obj = resolve_object_name(con, &ns, stat.argv[0]);
+    if (!obj) {
+        // Listing a namespace is not a failure
+        return ns != NULL;
+    }
+    if (con->journal) {
+        journal_append(con->journal, (int)(ns - con->nss), ns->name,
+                       (int)(obj - ns->schema->objs), &stat);
+    }
+    return exec_object(con, ns, obj, &stat);
+}
+
+bool canard_exec_fd(Console *con, int fd, CnRunStats *stats) {
+    CnRunStats ignored = {0, 0, 0};
+    if (!stats) {
+        stats = &ignored;
+    }
+    char *buf = malloc(EXEC_READ_SIZE + 1);
+    size_t len = 0;
+    bool skipping = false;
+    ssize_t n;
+    while ((n = read(fd, buf + len, EXEC_READ_SIZE - len)) > 0) {
+        stats->bytes += n;
+        char *line = buf;
+        char *end = buf + len + n;
+        char *nl;
+        while ((nl = memchr(line, '\n', end - line))) {
+            *nl = 0;
+            if (!skipping) {
+                exec_line(con, stats, line);
+            }
+            skipping = false;
+            line = nl + 1;
+        }
+        len = end - line;
+        if (len == EXEC_READ_SIZE) {
+            // A line longer than the whole buffer: run its head, drop the rest
+            buf[len] = 0;
+            if (!skipping) {
+                exec_line(con, stats, buf);
+            }
+            skipping = true;
+            len = 0;
+        } else {
+            memmove(buf, line, len);
+        }
+    }
+    if (len && !skipping) {
+        buf[len] = 0;
+        exec_line(con, stats, buf);
+    }
+    free(buf);
+    return n == 0;
+}
+
+bool canard_journal_open(Console *con, const char *path, size_t capacity) {
+    capacity = JOURNAL_ALIGN(capacity);
+    if (con->journal || !path ||
+        capacity < 4 * JOURNAL_ALIGN(sizeof(CnJournalRecord) +
+                                     CANARD_MAX_CMDLINE)) {
+        return false;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        fprintf(con->output, "%s: Failed to open journal\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    size_t map_size = sizeof(CnJournalHeader) + capacity;
+    // Only a new, empty file is sized; anything else must already be a
+    // journal of the same capacity, and is never overwritten
+    CnJournalHeader existing;
+    bool is_new = (st.st_size == 0);
+    if (is_new) {
+        if (ftruncate(fd, map_size)) {
+            fprintf(con->output, "%s: Failed to size journal\n", path);
+            close(fd);
+            return false;
+        }
+    } else if (pread(fd, &existing, sizeof(CnJournalHeader), 0) !=
+               sizeof(CnJournalHeader) ||
+               !journal_header_is_valid(&existing, st.st_size)) {
+        fprintf(con->output, "%s: Not a valid journal\n", path);
+        close(fd);
+        return false;
+    } else if (existing.capacity != capacity ||
+               (uint64_t)st.st_size != map_size) {
+        fprintf(con->output, "%s: Journal capacity is %llu bytes\n", path,
+                (unsigned long long)existing.capacity);
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(con->output, "%s: Failed to map journal\n", path);
+        return false;
+    }
+    
+    CnJournal *journal = malloc_zeroed(sizeof(CnJournal));
+    journal->header = map;
+    journal->ring = (uint8_t *)map + sizeof(CnJournalHeader);
+    journal->map_size = map_size;
+    CnJournalHeader *header = journal->header;
+    if (is_new) {
+        header->magic = JOURNAL_MAGIC;
+        header->version = JOURNAL_VERSION;
+        header->capacity = capacity;
+        header->head = 0;
+        header->tail = 0;
+    } else {
+        journal_recover(journal);
+    }
+    con->journal = journal;
+    return true;
+}
+
+void canard_journal_close(Console *con) {
+    if (!con->journal) {
+        return;
+    }
+    munmap(con->journal->header, con->journal->map_size);
+    free(con->journal);
+    con->journal = NULL;
+}
+
+int canard_journal_replay(Console *con, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(con->output, "%s: Failed to open journal\n", path);
+        return -1;
+    }
+    off_t map_size = lseek(fd, 0, SEEK_END);
+    void *map = MAP_FAILED;
+    if (map_size >= (off_t)sizeof(CnJournalHeader)) {
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(con->output, "%s: Failed to map journal\n", path);
+        return -1;
+    }
+    CnJournalHeader *header = map;
+    uint8_t *ring = (uint8_t *)map + sizeof(CnJournalHeader);
+    if (!journal_header_is_valid(header, map_size)) {
+        fprintf(con->output, "%s: Not a valid journal\n", path);
+        munmap(map, map_size);
+        return -1;
+    }
+    
+    int replayed = 0;
+    uint64_t pos = header->tail;
+    while (pos < header->head) {
+        const CnJournalRecord *rec = journal_record_at(header, ring, pos);
+        if (!journal_record_is_valid(header, rec, pos)) {
+            fprintf(con->output, "%s: Corrupt record at %llu\n", path,
+                    (unsigned long long)pos);
             break;
         }
-        if (*arg) {
-            stat.argv[stat.argc++] = arg;
+        pos += rec->size;
+        CnStatement stat;
+        const char *ns_name;
+        if (rec->ns_id == JOURNAL_PAD ||
+            !journal_read_statement(rec, &stat, &ns_name)) {
+            continue;
         }
-    } while (stat.argc < CANARD_MAX_ARGS);
-    if (stat.argc) {
-        CnObject *obj = resolve_object_name(con, stat.argv[0], NULL);
-        if (obj) {
-            switch (obj->type) {
-                case COBJ_CMD:
-                    break;
-                case COBJ_VAR:
-                    if (stat.argc > 2) {
-                        describe_object(con, obj);
-                    }
-                    break;
+        // Trust the recorded ids only if they still point to the same names
+        const char *dot = strchr(stat.argv[0], '.');
+        const char *obj_name = (dot ? dot + 1 : stat.argv[0]);
+        CnNamespace *ns = NULL;
+        const CnObject *obj = NULL;
+        if (rec->ns_id < CANARD_MAX_NAMESPACES &&
+            con->nss[rec->ns_id].name &&
+            !strcmp(con->nss[rec->ns_id].name, ns_name) &&
+            rec->obj_id < con->nss[rec->ns_id].schema->t_objs) {
+            ns = con->nss + rec->ns_id;
+            obj = ns->schema->objs + rec->obj_id;
+            if (strcmp(obj->name, obj_name)) {
+                obj = NULL;
             }
         }
+        if (!obj) {
+            ns = canard_find_namespace(con, ns_name);
+            obj = (ns ? canard_find_object(ns, obj_name) : NULL);
+        }
+        if (!obj) {
+            obj = resolve_object_name(con, &ns, stat.argv[0]);
+        }
+        if (obj) {
+            exec_object(con, ns, obj, &stat);
+            replayed++;
+        }
     }
+    munmap(map, map_size);
+    return replayed;
 }
 
-bool canard_get_cvar_bool(CnVariable *cvar) {
-    return cvar->value.b_val;
+bool canard_get_cvar_bool(CnNamespace *ns, const CnVariable *cvar) {
+    return ns->values[cvar->slot].b_val;
 }
 
-void canard_set_cvar_bool(Console *con, CnVariable *cvar, bool value) {
+bool canard_set_cvar_bool(Console *con, CnNamespace *ns,
+                          const CnVariable *cvar, bool value) {
     if (cvar->type != CVAR_BOOL) {
-        return;
+        return reject_set(con);
     }
-    if (cvar->value.b_val == value) {
-        return;
+    return set_cvar_value(con, ns, cvar, (CnVarValue){.b_val = value});
+}
+
+bool canard_toggle_cvar_bool(Console *con, CnNamespace *ns,
+                             const CnVariable *cvar) {
+    bool value = !canard_get_cvar_bool(ns, cvar);
+    canard_set_cvar_bool(con, ns, cvar, value);
+    return value;
+}
+
+int canard_get_cvar_int(CnNamespace *ns, const CnVariable *cvar) {
+    return ns->values[cvar->slot].i_val;
+}
+
+bool canard_set_cvar_int(Console *con, CnNamespace *ns,
+                         const CnVariable *cvar, int value) {
+    if (cvar->type != CVAR_INT) {
+        return reject_set(con);
     }
-    cvar->value.b_val = value;
-    handle_cvar_change(con, cvar);
+    return set_cvar_value(con, ns, cvar, (CnVarValue){.i_val = value});
 }
 
-const char *canard_get_cvar_str(CnVariable *cvar) {
-    return cvar->value.str;
+int64_t canard_get_cvar_int64(CnNamespace *ns, const CnVariable *cvar) {
+    return ns->values[cvar->slot].i64_val;
 }
 
-void canard_set_cvar_str(Console *con, CnVariable *cvar, const char *value) {
-    if (cvar->type != CVAR_STRING) {
-        return;
+bool canard_set_cvar_int64(Console *con, CnNamespace *ns,
+                           const CnVariable *cvar, int64_t value) {
+    if (cvar->type != CVAR_INT64) {
+        return reject_set(con);
     }
-    if (!strcmp(cvar->value.str, value)) {
-        return;
+    return set_cvar_value(con, ns, cvar, (CnVarValue){.i64_val = value});
+}
+
+float canard_get_cvar_float(CnNamespace *ns, const CnVariable *cvar) {
+    return ns->values[cvar->slot].f_val;
+}
+
+bool canard_set_cvar_float(Console *con, CnNamespace *ns,
+                           const CnVariable *cvar, float value) {
+    if (cvar->type != CVAR_FLOAT) {
+        return reject_set(con);
     }
-    
+    return set_cvar_value(con, ns, cvar, (CnVarValue){.f_val = value});
+}
+
+double canard_get_cvar_double(CnNamespace *ns, const CnVariable *cvar) {
+    return ns->values[cvar->slot].d_val;
+}
+
+bool canard_set_cvar_double(Console *con, CnNamespace *ns,
+                            const CnVariable *cvar, double value) {
+    if (cvar->type != CVAR_DOUBLE) {
+        return reject_set(con);
+    }
+    return set_cvar_value(con, ns, cvar, (CnVarValue){.d_val = value});
+}
+
+const char *canard_get_cvar_str(CnNamespace *ns, const CnVariable *cvar) {
+    return ns->values[cvar->slot].str;
 }
 
-void canard_reset_cvar(Console *con, CnVariable *cvar) {
+bool canard_set_cvar_str(Console *con, CnNamespace *ns,
+                         const CnVariable *cvar, const char *value) {
+    if (cvar->type != CVAR_STRING || !value) {
+        return reject_set(con);
+    }
+    return set_cvar_value(con, ns, cvar, (CnVarValue){.str = (char *)value});
+}
+
+void canard_reset_cvar(Console *con, CnNamespace *ns, const CnVariable *cvar) {
     switch (cvar->type) {
         case CVAR_BOOL:
-            canard_set_cvar_bool(con, cvar, cvar->default_value.b_val);
+            canard_set_cvar_bool(con, ns, cvar, cvar->default_value.b_val);
             break;
         case CVAR_INT:
-            canard_set_cvar_int(con, cvar, cvar->default_value.i_val);
+            canard_set_cvar_int(con, ns, cvar, cvar->default_value.i_val);
             break;
         case CVAR_STRING:
-            canard_set_cvar_str(con, cvar, cvar->default_value.str);
+            canard_set_cvar_str(con, ns, cvar, cvar->default_value.str);
+            break;
+        case CVAR_INT64:
+            canard_set_cvar_int64(con, ns, cvar, cvar->default_value.i64_val);
             break;
+        case CVAR_FLOAT:
+            canard_set_cvar_float(con, ns, cvar, cvar->default_value.f_val);
+            break;
+        case CVAR_DOUBLE:
+            canard_set_cvar_double(con, ns, cvar, cvar->default_value.d_val);
+            break;
+    }
+}
+
+bool canard_begin(Console *con) {
+    if (con->txn.active) {
+        return false;
     }
+    con->txn.active = true;
+    return true;
+}
+
+bool canard_commit(Console *con) {
+    CnTransaction *txn = &con->txn;
+    if (!txn->active) {
+        return false;
+    }
+    if (txn->failed) {
+        canard_rollback(con);
+        return false;
+    }
+    
+    // Detach the batch, so that callbacks may set variables or begin anew
+    CnStagedValue *staged = txn->staged;
+    int count = txn->count;
+    memset(txn, 0, sizeof(CnTransaction));
+    
+    publish_begin(con);
+    for (int i = 0; i < count; i++) {
+        CnStagedValue *entry = staged + i;
+        CnVarValue *current = entry->ns->values + entry->cvar->slot;
+        if (!values_equal(entry->cvar->type, current, &entry->value)) {
+            store_value(con, entry->cvar, current, entry->value);
+            entry->changed = true;
+        }
+    }
+    publish_end(con);
+    
+    for (int i = 0; i < count; i++) {
+        if (staged[i].changed) {
+            handle_cvar_change(con, staged[i].ns, staged[i].cvar);
+        }
+    }
+    free_staged(staged, count);
+    return true;
+}
+
+void canard_rollback(Console *con) {
+    free_staged(con->txn.staged, con->txn.count);
+    memset(&con->txn, 0, sizeof(CnTransaction));
+}
+
+unsigned canard_generation(Console *con) {
+    return atomic_load_explicit(&con->generation, memory_order_acquire) / 2;
+}
+
+unsigned canard_read_begin(Console *con) {
+    atomic_fetch_add_explicit(&con->readers, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned seq;
+    while ((seq = atomic_load_explicit(&con->generation,
+                                       memory_order_acquire)) & 1) {
+    }
+    return seq;
+}
+
+bool canard_read_retry(Console *con, unsigned seq) {
+    atomic_thread_fence(memory_order_acquire);
+    bool retry = (atomic_load_explicit(&con->generation,
+                                       memory_order_relaxed) != seq);
+    atomic_fetch_sub_explicit(&con->readers, 1, memory_order_release);
+    return retry;
 }
 
 void canard_parse_args(Console *con, int argc, const char **argv,
@@ -499,7 +2072,7 @@ void canard_parse_args(Console *con, int argc, const char **argv,
         }
         if (strlen(arg)) {
             if (dashed) {
-                new_cmd = cmdline;
+                new_cmd = arg;
                 stat_end = true;
             } else {
                 char *cmdline_cat = (strlen(cmdline) ? cmdline : cmdline_stray);
@@ -521,14 +2094,20 @@ void canard_parse_args(Console *con, int argc, const char **argv,
             }
         }
     }
+    // The last dashed statement has no following one to end it
+    if (strlen(cmdline)) {
+        canard_exec(con, cmdline);
+    }
     if (strlen(cmdline_stray) > strlen(default_command)) {
         canard_exec(con, cmdline_stray);
     }
 }
 
 bool canard_set_save_path(Console *con, const char *path) {
+    const CnVariable *cvar = &(canard_find_object(con->nss,
+                                                  "save_path")->sub.var);
     if (path) {
-        con->save_path = strdup(path);
+        canard_set_cvar_str(con, con->nss, cvar, path);
     } else {
         
     }
@@ -550,16 +2129,14 @@ CnNamespace *canard_find_namespace(Console *con, const char *name) {
     return NULL;
 }
 
-CnObject *canard_find_object(CnNamespace *ns, const char *name) {
+const CnObject *canard_find_object(CnNamespace *ns, const char *name) {
     if (name) {
-        for (int i = 0; i < ns->t_objs; i++) {
-            CnObject *obj = ns->objs + i;
-            if (!obj->name) {
-                break;
-            }
-            if (!strcmp(name, obj->name)) {
-                return obj;
-            }
+        const CnSchema *schema = ns->schema;
+        const CnObject **match = bsearch(name, schema->index, schema->t_objs,
+                                         sizeof(CnObject *),
+                                         compare_name_to_object);
+        if (match) {
+            return *match;
         }
     }
     return NULL;
@@ -1,6 +1,7 @@
 #ifndef canard_h
 #define canard_h
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -21,11 +22,20 @@
 #define CANARD_MAX_ARGS 10
 #endif
 
+#ifndef CANARD_MAX_SUGGESTIONS
+#define CANARD_MAX_SUGGESTIONS 5
+#endif
+
+#ifndef CANARD_SUGGEST_DISTANCE
+#define CANARD_SUGGEST_DISTANCE 2
+#endif
+
 #define END_CMD_DECL {NULL, NULL, NULL}
-#define END_VAR_DECL {NULL, NULL, 0, NULL, NULL}
+#define END_VAR_DECL {NULL, NULL, 0, NULL, NULL, NULL, NULL, NULL}
 
 typedef struct Console Console;
 typedef struct CnNamespace CnNamespace;
+typedef struct CnJournal CnJournal;
 
 typedef struct CnStatement {
     int argc;
@@ -37,29 +47,59 @@ typedef union CnVarValue {
     bool b_val;
     int i_val;
     char *str;
+    int64_t i64_val;
+    float f_val;
+    double d_val;
 } CnVarValue;
 
 typedef enum CnVarType {
     CVAR_BOOL,
     CVAR_INT,
     CVAR_STRING,
+    CVAR_INT64,
+    CVAR_FLOAT,
+    CVAR_DOUBLE,
 } CnVarType;
 
 typedef void (*CnVarCallback)(void *, Console *, CnVarValue *);
 
+/**
+ * Declaration of a variable. default_value, min and max point to a value of
+ * the variable's type; min and max only apply to numeric types. allowed is a
+ * NULL-terminated list of the only values a string variable may take.
+ * Values outside of those constraints are rejected before any callback.
+ * Constraints must fit the type, min may not exceed max, and the default
+ * value (an empty string when omitted) must satisfy them.
+ */
 typedef struct CnVarDecl {
     const char *name;
     CnVarCallback func;
     CnVarType type;
     const void *default_value;
     const char *description;
+    const void *min;
+    const void *max;
+    const char *const *allowed;
 } CnVarDecl;
 
+typedef struct CnVarConstraints {
+    bool has_min;
+    bool has_max;
+    CnVarValue min;
+    CnVarValue max;
+    int t_allowed;
+    const char *const *allowed;
+    uint32_t seed;
+    uint32_t slot_mask;
+    int *slots;
+} CnVarConstraints;
+
 typedef struct CnVariable {
     CnVarCallback func;
     CnVarType type;
     CnVarValue default_value;
-    CnVarValue value;
+    int slot;
+    const CnVarConstraints *constraints;
 } CnVariable;
 
 typedef bool (*CnCmdExec)(void *, Console *, const CnStatement *);
@@ -89,20 +129,103 @@ typedef struct CnObject {
     const char *description;
     CnObjectType type;
     CnSubObject sub;
-    CnNamespace *ns;
 } CnObject;
 
-typedef struct CnNamespace {
+/**
+ * Node of a trie over object names, used to suggest close matches for
+ * mistyped names. Node 0 is the root; obj is the index of the object whose
+ * name ends at the node, or -1. The children of a node are the t_children
+ * nodes starting at index child. Schemas hold one trie of the names, and one
+ * of the names spelled backwards.
+ */
+typedef struct CnTrieNode {
+    int child;
+    int t_children;
+    int obj;
+    char c;
+} CnTrieNode;
+
+/**
+ * Immutable description of a namespace: its objects, their types, defaults
+ * and the name lookup index. A schema is built once and can be shared
+ * read-only by any number of namespaces, in any number of consoles.
+ */
+typedef struct CnSchema {
     const char *name;
-    void *handler;
     int t_objs;
+    int t_vars;
     CnObject *objs;
-    CnStatement buffer[CANARD_MAX_BUFFER];
+    const CnObject **index;
+    int t_trie;
+    int t_rtrie;
+    CnTrieNode *trie;
+    CnTrieNode *rtrie;
+} CnSchema;
+
+/**
+ * Per-console state of a namespace. Variable values live in a compact array
+ * indexed by CnVariable.slot; string values point to the schema's default
+ * until they are first changed (copy-on-write). The buffer of command
+ * statements awaiting a handler is only allocated (CANARD_MAX_BUFFER entries)
+ * once needed, and freed when they are run.
+ */
+typedef struct CnNamespace {
+    Console *con;
+    const char *name;
+    const CnSchema *schema;
+    CnSchema *owned_schema;
+    void *handler;
+    CnVarValue *values;
+    int t_buffered;
+    CnStatement *buffer;
 } CnNamespace;
 
+typedef struct CnStagedValue {
+    CnNamespace *ns;
+    const CnVariable *cvar;
+    CnVarValue value;
+    bool changed;
+} CnStagedValue;
+
+/**
+ * Counters accumulated by canard_exec_fd().
+ */
+typedef struct CnRunStats {
+    long statements;
+    long errors;
+    size_t bytes;
+} CnRunStats;
+
+/**
+ * Variable changes staged between canard_begin() and canard_commit().
+ * failed is set once any set is rejected, which dooms the whole batch.
+ */
+typedef struct CnTransaction {
+    bool active;
+    bool failed;
+    int count;
+    int capacity;
+    CnStagedValue *staged;
+} CnTransaction;
+
+/**
+ * String values replaced by a publication. They are only freed once no
+ * reader is in progress, so that concurrent readers never copy freed memory.
+ */
+typedef struct CnRetiredStrings {
+    int count;
+    int capacity;
+    char **strs;
+} CnRetiredStrings;
+
 typedef struct Console {
     const char *app_name;
     FILE *output;
+    CnJournal *journal;
+    CnTransaction txn;
+    CnRetiredStrings retired;
+    atomic_uint generation;
+    atomic_uint readers;
     CnNamespace nss[CANARD_MAX_NAMESPACES];
 } Console;
 
@@ -122,7 +245,34 @@ void canard_init(Console *con, const char *app_name);
 void canard_teardown(Console *con);
 
 /**
- * Create a namespace.
+ * Build a shareable schema out of command and variable declarations.
+ * @param name Required. String identifier of the namespaces using the schema.
+ * @param cmds Optional. Command declarations, terminated by END_CMD_DECL.
+ * @param vars Optional. Variable declarations, terminated by END_VAR_DECL.
+ * @return The newly created schema, or NULL if no objects were declared, two
+ *         objects share the same name, the name was NULL, or a variable's
+ *         constraints are invalid (see CnVarDecl).
+ */
+CnSchema *canard_create_schema(const char *name, const CnCmdDecl *cmds,
+                               const CnVarDecl *vars);
+
+/**
+ * Free a schema. Every namespace using it must have been torn down first.
+ */
+void canard_destroy_schema(CnSchema *schema);
+
+/**
+ * Create a namespace from a shared schema. Only the variable values are
+ * allocated; the schema must outlive the console.
+ * @param con Required. The Console struct that will hold the new namespace.
+ * @param schema Required. The schema describing the namespace.
+ * @return The newly created namespace struct, or NULL if the namespace table
+ *         has been exhaused, or a namespace of the same name already exists.
+ */
+CnNamespace *canard_attach_namespace(Console *con, const CnSchema *schema);
+
+/**
+ * Create a namespace, with a schema private to it.
  * @param con Required. The Console struct that will hold the new namespace.
  * @param name Required. String identifier of the new namespace.
  * @return The newly created namespace struct, or NULL if the namespace table
@@ -132,41 +282,13 @@ CnNamespace *canard_create_namespace(Console *con, const char *name,
                                      const CnCmdDecl *cmds,
                                      const CnVarDecl *vars);
 
-/**
- * Create a command within a given namespace.
- * @param ns Required. The namespace that will hold the new command.
- * @param name Required. String identifier of the new command.
- * @param func Optional. The execution function to call upon usage.
- * @param description Required. Description of the new command.
- * @return The newly created variable struct, or NULL if the namespace is full,
- *         or the name is already used, or one of the required parameters was
- *         NULL.
- */
-CnObject *canard_create_command(CnNamespace *ns, const char *name,
-                                CnCmdExec func,
-                                const char *description);
-
-/**
-* Create a variable within a given namespace.
-* @param ns Required. The namespace that will hold the new variable.
-* @param name Required. String identifier of the new variable.
-* @param type The variable type of the new variable.
-* @param func Optional. The change callback function to be called whenever the
-*             variable has been changed (and the namespace handler has been
-*             defined).
-* @return The newly created variable struct, or NULL if the namespace is full,
-*         or the name is already used, or one of the required parameters was
-*         NULL.
-*/
-CnObject *canard_create_variable(CnNamespace *ns, const char *name,
-                                 CnVarType type, CnVarCallback func,
-                                 const char *description);
-
 /**
  * Define (or remove) a handler pointer for a given namespace. Until said handler is
  * defined, all variable change callbacks are ignored, and all command
  * executions are buffered until this function is called. Whenever one of those
  * functions are called, their first parameter will be set to that handler.
+ * Up to CANARD_MAX_BUFFER commands are buffered; they are run in order as soon
+ * as a handler is set.
  * @param ns Required.
  * @param handler Optional. The handler pointer to set, or NULL to remove the
  *                current one.
@@ -175,20 +297,129 @@ void canard_namespace_set_handler(CnNamespace *ns, void *handler);
 
 /**
  * Execute a given console statement.
+ * @return false if the statement is longer than CANARD_MAX_CMDLINE - 1
+ *         characters, could not be resolved, or its execution failed (invalid
+ *         value, a command reporting an error, or a full command buffer).
+ */
+bool canard_exec(Console *con, const char *cmdline);
+
+/**
+ * Execute every line read from a file descriptor until its end, such as a
+ * config file or a script piped to standard input. Leading blanks are
+ * ignored, and so are empty lines and lines starting with '#'. Input is read
+ * in large chunks and lines are terminated in place, so no per-line copy or
+ * stdio call is made.
+ * @param stats Optional. Counters to add the executed statements, the failed
+ *              ones and the bytes read to.
+ * @return false if reading failed.
+ */
+bool canard_exec_fd(Console *con, int fd, CnRunStats *stats);
+
+/**
+ * Start journaling every statement executed by canard_exec() into a
+ * memory-mapped ring buffer file. Each statement is stored as a binary record
+ * holding a timestamp, the resolved namespace and object ids, and the
+ * arguments; once the ring is full, the oldest records are overwritten.
+ * Appending a record does not perform any system call.
+ * A missing or empty file is created; an existing journal with the same
+ * capacity is appended to. Any other file is left untouched.
+ * @param path Required. Path of the journal file.
+ * @param capacity Size of the ring in bytes, excluding the file header.
+ * @return false if the journal could not be opened, the file is not a journal
+ *         of that capacity, the capacity is too small or a journal is already
+ *         open.
+ */
+bool canard_journal_open(Console *con, const char *path, size_t capacity);
+
+/**
+ * Stop journaling and unmap the journal file. Also done by canard_teardown().
+ */
+void canard_journal_close(Console *con);
+
+/**
+ * Re-execute every statement in a journal file, oldest first. The recorded
+ * object ids are used directly when they still match the console's
+ * namespaces, otherwise the statement name is resolved again. Replayed
+ * statements are not journaled.
+ * @return The number of statements replayed, or -1 if the file is not a
+ *         valid journal.
  */
-void canard_exec(Console *con, const char *cmdline);
+int canard_journal_replay(Console *con, const char *path);
 
-bool canard_get_cvar_bool(CnVariable *cvar);
-void canard_set_cvar_bool(Console *con, CnVariable *cvar, bool value);
-bool canard_toggle_cvar_bool(Console *con, CnVariable *cvar);
+/**
+ * The canard_set_cvar_*() functions return false if the variable is not of
+ * the given type, or the value does not satisfy its constraints.
+ */
+bool canard_get_cvar_bool(CnNamespace *ns, const CnVariable *cvar);
+bool canard_set_cvar_bool(Console *con, CnNamespace *ns,
+                          const CnVariable *cvar, bool value);
+bool canard_toggle_cvar_bool(Console *con, CnNamespace *ns,
+                             const CnVariable *cvar);
+
+int canard_get_cvar_int(CnNamespace *ns, const CnVariable *cvar);
+bool canard_set_cvar_int(Console *con, CnNamespace *ns,
+                         const CnVariable *cvar, int value);
+
+int64_t canard_get_cvar_int64(CnNamespace *ns, const CnVariable *cvar);
+bool canard_set_cvar_int64(Console *con, CnNamespace *ns,
+                           const CnVariable *cvar, int64_t value);
+
+float canard_get_cvar_float(CnNamespace *ns, const CnVariable *cvar);
+bool canard_set_cvar_float(Console *con, CnNamespace *ns,
+                           const CnVariable *cvar, float value);
+
+double canard_get_cvar_double(CnNamespace *ns, const CnVariable *cvar);
+bool canard_set_cvar_double(Console *con, CnNamespace *ns,
+                            const CnVariable *cvar, double value);
+
+const char *canard_get_cvar_str(CnNamespace *ns, const CnVariable *cvar);
+bool canard_set_cvar_str(Console *con, CnNamespace *ns,
+                         const CnVariable *cvar, const char *value);
+
+void canard_reset_cvar(Console *con, CnNamespace *ns, const CnVariable *cvar);
+
+/**
+ * Start staging variable changes. Until canard_commit() or canard_rollback()
+ * is called, canard_set_cvar_*() calls only record the new value: reads keep
+ * returning the published values, and no change callback is called.
+ * @return false if a transaction is already in progress.
+ */
+bool canard_begin(Console *con);
 
-int canard_get_cvar_int(Console *con, CnVariable *cvar);
-void canard_set_cvar_int(Console *con, CnVariable *cvar, int value);
+/**
+ * Publish all the staged changes at once. The console generation is advanced
+ * a single time for the whole batch, and the change callbacks of the
+ * variables that did change are only called once everything is published.
+ * If any set was rejected since canard_begin() (wrong type, unparsable or
+ * invalid value), nothing is published and every staged change is discarded.
+ * @return false if no transaction was in progress, or a set was rejected.
+ */
+bool canard_commit(Console *con);
+
+/**
+ * Discard all the staged changes.
+ */
+void canard_rollback(Console *con);
 
-const char *canard_get_cvar_str(CnVariable *cvar);
-void canard_set_cvar_str(Console *con, CnVariable *cvar, const char *value);
+/**
+ * Number of times variable changes have been published on the console.
+ */
+unsigned canard_generation(Console *con);
 
-void canard_reset_cvar(Console *con, CnVariable *cvar);
+/**
+ * Consistent reads from other threads, while a single thread sets variables:
+ *     unsigned seq;
+ *     do {
+ *         seq = canard_read_begin(con);
+ *         width = canard_get_cvar_int(ns, width_cvar);
+ *         height = canard_get_cvar_int(ns, height_cvar);
+ *     } while (canard_read_retry(con, seq));
+ * String values must be copied inside the loop. Every canard_read_begin() is
+ * paired with one canard_read_retry(), and replaced strings are only freed
+ * by a publication that finds no read in progress, however long it takes.
+ */
+unsigned canard_read_begin(Console *con);
+bool canard_read_retry(Console *con, unsigned seq);
 
 /**
  * Parse the command-line arguments passed to the application's main(), and
@@ -215,6 +446,6 @@ void canard_parse_args(Console *con, int argc, const char **argv,
 bool canard_set_save_path(Console *con, const char *path);
 
 CnNamespace *canard_find_namespace(Console *con, const char *name);
-CnObject *canard_find_object(CnNamespace *ns, const char *name);
+const CnObject *canard_find_object(CnNamespace *ns, const char *name);
 
 #endif /* canard_h */
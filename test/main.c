@@ -0,0 +1,292 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/canard.h"
+
+#define T_NAMES 20000
+#define T_QUERIES 3000
+#define T_NUMBERS 100000
+#define NAME_SIZE 16
+#define OUTPUT_SIZE 4096
+
+static int failures = 0;
+
+static void fail(const char *format, ...) {
+    // Only the first few failures are worth reading
+    if (failures++ < 10) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+    }
+}
+
+/*
+ * Execute a statement, and capture what it printed into out.
+ */
+static bool exec_capture(Console *con, const char *statement, char *out) {
+    rewind(con->output);
+    ftruncate(fileno(con->output), 0);
+    bool ok = canard_exec(con, statement);
+    fflush(con->output);
+    rewind(con->output);
+    size_t len = fread(out, 1, OUTPUT_SIZE - 1, con->output);
+    out[len] = 0;
+    return ok;
+}
+
+static int levenshtein(const char *a, const char *b) {
+    int len_b = (int)strlen(b);
+    int row[len_b + 1];
+    for (int j = 0; j <= len_b; j++) {
+        row[j] = j;
+    }
+    for (int i = 1; a[i - 1]; i++) {
+        int diagonal = row[0];
+        row[0] = i;
+        for (int j = 1; j <= len_b; j++) {
+            int above = row[j];
+            int best = diagonal + (a[i - 1] != b[j - 1]);
+            if (above + 1 < best) {
+                best = above + 1;
+            }
+            if (row[j - 1] + 1 < best) {
+                best = row[j - 1] + 1;
+            }
+            row[j] = best;
+            diagonal = above;
+        }
+    }
+    return row[len_b];
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Names over a 5-letter alphabet are dense enough for most queries to have
+ * many neighbours within the suggestion distance, so the pruned trie search
+ * is compared against a brute-force scan of every name.
+ */
+static void test_suggestions(void) {
+    char (*names)[NAME_SIZE] = malloc(sizeof(*names) * T_NAMES);
+    for (int i = 0; i < T_NAMES; i++) {
+        int len = 3 + rand() % 8;
+        for (int j = 0; j < len; j++) {
+            names[i][j] = 'a' + rand() % 5;
+        }
+        names[i][len] = 0;
+    }
+    qsort(names, T_NAMES, NAME_SIZE, compare_names);
+    int t_names = 0;
+    for (int i = 0; i < T_NAMES; i++) {
+        if (!t_names || strcmp(names[t_names - 1], names[i])) {
+            memmove(names[t_names++], names[i], NAME_SIZE);
+        }
+    }
+    CnVarDecl *vars = calloc(t_names + 1, sizeof(CnVarDecl));
+    for (int i = 0; i < t_names; i++) {
+        vars[i].name = names[i];
+        vars[i].type = CVAR_INT;
+    }
+
+    Console con;
+    canard_init(&con, "canard_test");
+    con.output = tmpfile();
+    CnSchema *schema = canard_create_schema("x", NULL, vars);
+    canard_attach_namespace(&con, schema);
+
+    char out[OUTPUT_SIZE];
+    for (int q = 0; q < T_QUERIES; q++) {
+        char query[NAME_SIZE];
+        int len = 1 + rand() % 10;
+        for (int j = 0; j < len; j++) {
+            query[j] = 'a' + rand() % 5;
+        }
+        query[len] = 0;
+        if (bsearch(query, names, t_names, NAME_SIZE, compare_names)) {
+            continue;
+        }
+
+        int expected[CANARD_MAX_SUGGESTIONS];
+        int t_expected = 0;
+        for (int dist = 1; dist <= CANARD_SUGGEST_DISTANCE; dist++) {
+            for (int i = 0; i < t_names &&
+                 t_expected < CANARD_MAX_SUGGESTIONS; i++) {
+                if (levenshtein(query, names[i]) == dist) {
+                    expected[t_expected++] = dist;
+                }
+            }
+        }
+
+        char statement[NAME_SIZE + 2];
+        snprintf(statement, sizeof(statement), "x.%s", query);
+        exec_capture(&con, statement, out);
+        int found[CANARD_MAX_SUGGESTIONS + 1];
+        int t_found = 0;
+        for (char *line = strstr(out, "\tx."); line && t_found <=
+             CANARD_MAX_SUGGESTIONS; line = strstr(line, "\tx.")) {
+            line += 3;
+            char *end = strchr(line, '\n');
+            *end = 0;
+            found[t_found++] = levenshtein(query, line);
+            line = end + 1;
+        }
+        qsort(found, t_found, sizeof(int), compare_ints);
+        if (t_found != t_expected ||
+            memcmp(found, expected, sizeof(int) * t_found)) {
+            fail("suggestions for \"%s\": %d found, %d expected\n", query,
+                 t_found, t_expected);
+        }
+    }
+
+    fclose(con.output);
+    canard_teardown(&con);
+    canard_destroy_schema(schema);
+    free(vars);
+    free(names);
+}
+
+static void random_decimal(char *buf, int i) {
+    int mantissa = rand() % 20000000;
+    switch (i % 3) {
+        case 0:
+            snprintf(buf, NAME_SIZE * 2, "%de%d", mantissa, rand() % 25 - 12);
+            break;
+        case 1:
+            snprintf(buf, NAME_SIZE * 2, "%d.%03d", mantissa, rand() % 1000);
+            break;
+        default:
+            snprintf(buf, NAME_SIZE * 2, "-%de%d", rand(), rand() % 90 - 45);
+            break;
+    }
+}
+
+static double random_bits(bool single) {
+    uint64_t bits = ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 11) ^
+                    (uint64_t)rand();
+    if (single) {
+        uint32_t low = (uint32_t)bits;
+        float f;
+        memcpy(&f, &low, sizeof(float));
+        return f;
+    }
+    double d;
+    memcpy(&d, &bits, sizeof(double));
+    return d;
+}
+
+static size_t shortest_length(double value, bool single) {
+    char buf[NAME_SIZE * 2];
+    for (int precision = 1; ; precision++) {
+        snprintf(buf, sizeof(buf), "%.*g", precision, value);
+        if (single ? strtof(buf, NULL) == (float)value :
+            strtod(buf, NULL) == value) {
+            return strlen(buf);
+        }
+    }
+}
+
+/*
+ * Values are checked through the console: parsing against strtof() and
+ * strtod(), and the printed current value for exact round-tripping and for
+ * being as short as the shortest %g representation.
+ */
+static void test_numbers(void) {
+    static const CnVarDecl vars[] = {
+        {"f", NULL, CVAR_FLOAT},
+        {"d", NULL, CVAR_DOUBLE},
+        END_VAR_DECL
+    };
+    Console con;
+    canard_init(&con, "canard_test");
+    con.output = tmpfile();
+    CnNamespace *ns = canard_create_namespace(&con, "n", NULL, vars);
+    const CnVariable *f_cvar = &canard_find_object(ns, "f")->sub.var;
+    const CnVariable *d_cvar = &canard_find_object(ns, "d")->sub.var;
+
+    char number[NAME_SIZE * 2];
+    char statement[NAME_SIZE * 3];
+    char out[OUTPUT_SIZE];
+    for (int i = 0; i < T_NUMBERS; i++) {
+        random_decimal(number, i);
+        for (int single = 0; single < 2; single++) {
+            double expected = (single ? strtof(number, NULL) :
+                               strtod(number, NULL));
+            snprintf(statement, sizeof(statement), "n.%s %s",
+                     (single ? "f" : "d"), number);
+            bool ok = exec_capture(&con, statement, out);
+            double parsed = (single ? canard_get_cvar_float(ns, f_cvar) :
+                             canard_get_cvar_double(ns, d_cvar));
+            if (isinf(expected) ? ok : (!ok || parsed != expected)) {
+                fail("parsing %s \"%s\": got %.17g, expected %.17g\n",
+                     (single ? "float" : "double"), number, parsed, expected);
+            }
+        }
+
+        for (int single = 0; single < 2; single++) {
+            double value = (i % 2 ? random_bits(single) :
+                            single ? strtof(number, NULL) :
+                            strtod(number, NULL));
+            if (!isfinite(value)) {
+                continue;
+            }
+            if (single) {
+                canard_set_cvar_float(&con, ns, f_cvar, (float)value);
+            } else {
+                canard_set_cvar_double(&con, ns, d_cvar, value);
+            }
+            exec_capture(&con, (single ? "n.f" : "n.d"), out);
+            char *current = strstr(out, "Current: ") + 9;
+            *strchr(current, '\n') = 0;
+            double back = (single ? strtof(current, NULL) :
+                           strtod(current, NULL));
+            if (back != value || strlen(current) >
+                shortest_length(value, single)) {
+                fail("formatting %s %.17g: got \"%s\"\n",
+                     (single ? "float" : "double"), value, current);
+            }
+        }
+    }
+
+    // Subnormals, overflow and large integers
+    canard_set_cvar_double(&con, ns, d_cvar, 5e-324);
+    exec_capture(&con, "n.d", out);
+    if (!strstr(out, "Current: 5e-324\n")) {
+        fail("5e-324 is not printed minimally\n");
+    }
+    canard_set_cvar_float(&con, ns, f_cvar, 1e14f);
+    exec_capture(&con, "n.f", out);
+    if (!strstr(out, "Current: 1e+14\n")) {
+        fail("1e14f is not printed minimally\n");
+    }
+    if (exec_capture(&con, "n.f 1e39", out) ||
+        exec_capture(&con, "n.d 1e309", out)) {
+        fail("overflowing values are accepted\n");
+    }
+
+    fclose(con.output);
+    canard_teardown(&con);
+}
+
+int main(int argc, const char *argv[]) {
+    srand(1);
+    test_suggestions();
+    test_numbers();
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
+}